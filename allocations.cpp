@@ -0,0 +1,81 @@
+/*
+    EDSM: Elastic Degenerate String Matching
+
+    Copyright (C) 2017 Chang Liu, Solon P. Pissis, Ahmad Retha and Fatima Vayani.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstdlib>
+#include <new>
+#include "allocations.hpp"
+
+using namespace std;
+
+/**
+* The number of heap allocations made by the calling thread
+*/
+static thread_local unsigned long int heapAllocations = 0;
+
+void * operator new(size_t n)
+{
+    void * p = malloc(n > 0 ? n : 1);
+    if (p == NULL) {
+        throw bad_alloc();
+    }
+    heapAllocations++;
+    return p;
+}
+
+void * operator new[](size_t n)
+{
+    return operator new(n);
+}
+
+void * operator new(size_t n, const nothrow_t &) noexcept
+{
+    heapAllocations++;
+    return malloc(n > 0 ? n : 1);
+}
+
+void * operator new[](size_t n, const nothrow_t &) noexcept
+{
+    return operator new(n, nothrow);
+}
+
+void operator delete(void * p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void * p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void * p, const nothrow_t &) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void * p, const nothrow_t &) noexcept
+{
+    free(p);
+}
+
+/**
+* Get the number of heap allocations made so far by the calling thread
+*/
+unsigned long int getHeapAllocations()
+{
+    return heapAllocations;
+}
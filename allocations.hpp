@@ -0,0 +1,29 @@
+/*
+    EDSM: Elastic Degenerate String Matching
+
+    Copyright (C) 2017 Chang Liu, Solon P. Pissis, Ahmad Retha and Fatima Vayani.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __ALLOCATIONS__
+#define __ALLOCATIONS__
+
+/**
+ * operator new is replaced to count the heap allocations made by each thread,
+ * so every allocation of a search shows up in EDSM::getAllocations(),
+ * whichever container, bit-vector or kernel buffer makes it. Counting costs
+ * an increment of a thread-local variable per allocation.
+ */
+unsigned long int getHeapAllocations();
+
+#endif
@@ -0,0 +1,492 @@
+/*
+    EDSM: Elastic Degenerate String Matching
+
+    Copyright (C) 2017 Chang Liu, Solon P. Pissis, Ahmad Retha and Fatima Vayani.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include "binaryeds.hpp"
+
+using namespace std;
+
+/**
+* The lookup tables of the 2-bit codes of the bases
+*/
+struct PackTable
+{
+    unsigned char code[256];
+
+    bool isException[256];
+
+    PackTable()
+    {
+        const char * bases = "ACGT";
+        memset(this->code, 0, sizeof(this->code));
+        memset(this->isException, 1, sizeof(this->isException));
+        for (unsigned int c = 0; c < 4; c++)
+        {
+            this->code[(int)bases[c]] = c;
+            this->isException[(int)bases[c]] = false;
+        }
+    }
+};
+
+/**
+* Get the lookup tables of the bases, built once for all threads
+*
+* @return The tables
+*/
+static const PackTable & packTable()
+{
+    static const PackTable table;
+    return table;
+}
+
+/**
+* Copy a table into a file image, of which it may be empty
+*
+* @param out Where the table goes
+* @param table The table
+* @param n The size of the table in bytes
+* @return The end of the table in the image
+*/
+static char * copyTable(char * out, const void * table, const size_t n)
+{
+    if (n > 0) {
+        memcpy(out, table, n);
+    }
+    return out + n;
+}
+
+/**
+* @constructor
+*/
+BinaryEDSWriter::BinaryEDSWriter()
+{
+    this->segmentStart.assign(1, 0);
+    this->bases = 0;
+}
+
+/**
+* Append a segment. Anything but A, C, G and T is stored as N, which EDSM
+* treats the same way: it never matches a pattern.
+*
+* @param S The strings of the segment, epsilon being an empty string
+* @param n The number of strings in S
+*/
+void BinaryEDSWriter::push(const StringView * S, const unsigned int n)
+{
+    const PackTable & table = packTable();
+    uint64_t i = this->bases;
+    unsigned int s, j;
+    unsigned char c;
+
+    for (s = 0; s < n; s++)
+    {
+        for (j = 0; j < S[s].length; j++, i++)
+        {
+            if (i % 32 == 0) {
+                this->packed.push_back(0);
+            }
+            c = S[s].data[j];
+            if (table.isException[c])
+            {
+                size_t runs = this->exceptions.size();
+                if (runs > 0 && this->exceptions[runs - 2] + this->exceptions[runs - 1] == i) {
+                    this->exceptions[runs - 1]++;
+                } else {
+                    this->exceptions.push_back(i);
+                    this->exceptions.push_back(1);
+                }
+            }
+            this->packed.back() |= (uint64_t) table.code[c] << (2 * (i % 32));
+        }
+        this->stringLength.push_back(S[s].length);
+    }
+    this->bases = i;
+    this->segmentStart.push_back(this->stringLength.size());
+}
+
+/**
+* Append a segment
+*
+* @param S The strings of the segment, epsilon being an empty string
+*/
+void BinaryEDSWriter::push(const Segment & S)
+{
+    vector<StringView> views(S.size());
+    for (unsigned int s = 0; s < S.size(); s++)
+    {
+        views[s].data = S[s].data();
+        views[s].length = S[s].length();
+    }
+    this->push(views.data(), views.size());
+}
+
+/**
+* Get the header of the segments appended so far
+*/
+BinaryEDSHeader BinaryEDSWriter::getHeader() const
+{
+    BinaryEDSHeader header;
+    memcpy(header.magic, BINARYEDSMAGIC, sizeof(header.magic));
+    header.segments = this->segmentStart.size() - 1;
+    header.strings = this->stringLength.size();
+    header.bases = this->bases;
+    header.exceptions = this->exceptions.size() / 2;
+    return header;
+}
+
+/**
+* Write the segments appended so far to a file
+*
+* @param name The path of the file
+* @return Was the file written?
+*/
+bool BinaryEDSWriter::save(const string & name) const
+{
+    BinaryEDSHeader header = this->getHeader();
+
+    ofstream out(name.c_str(), ios::out | ios::binary | ios::trunc);
+    if (!out.good()) {
+        return false;
+    }
+    out.write((const char *) &header, sizeof(header));
+    out.write((const char *) this->segmentStart.data(), this->segmentStart.size() * sizeof(uint64_t));
+    out.write((const char *) this->packed.data(), this->packed.size() * sizeof(uint64_t));
+    out.write((const char *) this->exceptions.data(), this->exceptions.size() * sizeof(uint64_t));
+    out.write((const char *) this->stringLength.data(), this->stringLength.size() * sizeof(uint32_t));
+    out.close();
+
+    return !out.fail();
+}
+
+/**
+* Lay out the segments appended so far in memory as they would be in a file,
+* to be read by a BinaryEDS without writing them
+*
+* @param image Set to the contents of the file, in words so it is aligned
+* @return The size of the file in bytes, the last word being padded
+*/
+size_t BinaryEDSWriter::getImage(vector<uint64_t> & image) const
+{
+    BinaryEDSHeader header = this->getHeader();
+    size_t n = sizeof(header) + (this->segmentStart.size() + this->packed.size() + this->exceptions.size()) * sizeof(uint64_t) + this->stringLength.size() * sizeof(uint32_t);
+
+    image.assign((n + sizeof(uint64_t) - 1) / sizeof(uint64_t), 0);
+    char * out = (char *) image.data();
+    out = copyTable(out, &header, sizeof(header));
+    out = copyTable(out, this->segmentStart.data(), this->segmentStart.size() * sizeof(uint64_t));
+    out = copyTable(out, this->packed.data(), this->packed.size() * sizeof(uint64_t));
+    out = copyTable(out, this->exceptions.data(), this->exceptions.size() * sizeof(uint64_t));
+    copyTable(out, this->stringLength.data(), this->stringLength.size() * sizeof(uint32_t));
+
+    return n;
+}
+
+/**
+* Get the number of segments appended
+*/
+uint64_t BinaryEDSWriter::getSegments() const
+{
+    return this->segmentStart.size() - 1;
+}
+
+/**
+* Get the number of bases appended
+*/
+uint64_t BinaryEDSWriter::getBases() const
+{
+    return this->bases;
+}
+
+/**
+* @constructor
+*/
+BinaryEDS::BinaryEDS()
+{
+    this->header = NULL;
+    this->segmentStart = NULL;
+    this->packed = NULL;
+    this->exceptions = NULL;
+    this->stringLength = NULL;
+    this->segment = 0;
+    this->base = 0;
+    this->exception = 0;
+    this->corrupt = false;
+}
+
+/**
+* Does a file hold binary EDS rather than EDS text?
+*
+* @param t The contents of the file
+* @param n The length of t
+* @return Does t start with the magic number of binary EDS?
+*/
+bool BinaryEDS::isBinary(const char * t, const size_t n)
+{
+    return n >= sizeof(BinaryEDSHeader) && memcmp(t, BINARYEDSMAGIC, 8) == 0;
+}
+
+/**
+* Use a binary EDS file held in memory, which must stay there while it is read.
+* The sizes of the tables are checked here, their contents as the segments are
+* read.
+*
+* @param t The contents of the file, aligned to 8 bytes
+* @param n The length of t
+* @return Is t a binary EDS file?
+*/
+bool BinaryEDS::load(const char * t, const size_t n)
+{
+    if (!BinaryEDS::isBinary(t, n) || ((uintptr_t) t) % sizeof(uint64_t) != 0) {
+        return false;
+    }
+
+    const BinaryEDSHeader * header = (const BinaryEDSHeader *) t;
+    uint64_t words = (n - sizeof(BinaryEDSHeader)) / sizeof(uint64_t);
+    if (header->segments >= words || header->strings / 2 > words || header->exceptions > words / 2 || header->bases / 32 >= words) {
+        return false;
+    }
+    uint64_t packedWords = (header->bases + 31) / 32;
+    if (n != sizeof(BinaryEDSHeader) + (header->segments + 1 + packedWords + 2 * header->exceptions) * sizeof(uint64_t) + header->strings * sizeof(uint32_t)) {
+        return false;
+    }
+
+    this->header = header;
+    this->segmentStart = (const uint64_t *) (t + sizeof(BinaryEDSHeader));
+    this->packed = this->segmentStart + header->segments + 1;
+    this->exceptions = this->packed + packedWords;
+    this->stringLength = (const uint32_t *) (this->exceptions + 2 * header->exceptions);
+    this->segment = 0;
+    this->base = 0;
+    this->exception = 0;
+    this->corrupt = false;
+
+    return this->segmentStart[0] == 0 && this->segmentStart[header->segments] == header->strings;
+}
+
+/**
+* Unpack the bases [from, to) and put back the Ns among them. A run of Ns that
+* goes on after to is kept for the next segment.
+*
+* @param from The index of the first base
+* @param to The index after the last base
+* @param out Where the bases are written, to - from of them
+*/
+void BinaryEDS::unpack(const uint64_t from, const uint64_t to, char * out)
+{
+    PackedView a;
+    a.packed = (const WORD *) this->packed;
+    a.from = from;
+    a.length = to - from;
+    this->takeRuns(a);
+    unpackView(a, out);
+}
+
+/**
+* Point a string at the runs of Ns that overlap it and move past those that
+* end in it. The string must not start before the runs already passed.
+*
+* @param a The string, whose packed, from and length are set
+*/
+void BinaryEDS::takeRuns(PackedView & a)
+{
+    const uint64_t to = a.from + a.length;
+    while (this->exception < this->header->exceptions && this->exceptions[2 * this->exception] + this->exceptions[2 * this->exception + 1] <= a.from) {
+        this->exception++;
+    }
+    a.exceptions = (const WORD *) this->exceptions + 2 * this->exception;
+    a.n = 0;
+    while (this->exception + a.n < this->header->exceptions && this->exceptions[2 * (this->exception + a.n)] < to) {
+        a.n++;
+    }
+    while (this->exception < this->header->exceptions && this->exceptions[2 * this->exception] + this->exceptions[2 * this->exception + 1] <= to) {
+        this->exception++;
+    }
+}
+
+/**
+* Read the next segment
+*
+* @param S Set to the strings of the segment, valid until the next call
+* @return Was there a segment left? false at the end or if the tables are inconsistent
+*/
+bool BinaryEDS::nextSegment(vector<StringView> & S)
+{
+    if (this->header == NULL || this->corrupt || this->segment >= this->header->segments) {
+        return false;
+    }
+
+    uint64_t first = this->segmentStart[this->segment];
+    uint64_t last = this->segmentStart[this->segment + 1];
+    uint64_t k, from = this->base, to = this->base;
+    if (last < first || last > this->header->strings)
+    {
+        this->corrupt = true;
+        return false;
+    }
+    for (k = first; k < last; k++) {
+        to += this->stringLength[k];
+    }
+    if (to > this->header->bases)
+    {
+        this->corrupt = true;
+        return false;
+    }
+
+    //the whole segment is unpacked at once, so the buffer is never reallocated under the views
+    this->buffer.resize(to - from);
+    this->unpack(from, to, &this->buffer[0]);
+
+    S.clear();
+    StringView a;
+    a.data = this->buffer.data();
+    for (k = first; k < last; k++)
+    {
+        a.length = this->stringLength[k];
+        S.push_back(a);
+        a.data += a.length;
+    }
+    this->segment++;
+    this->base = to;
+
+    return true;
+}
+
+/**
+* Take the next segment without unpacking it if it is determinate
+*
+* @param a Set to the bases of the segment, which point into the file
+* @return Is there a next segment and is it determinate? If not, nothing is taken
+*/
+bool BinaryEDS::nextPackedSegment(PackedView & a)
+{
+    if (this->header == NULL || this->corrupt || this->segment >= this->header->segments) {
+        return false;
+    }
+
+    uint64_t first = this->segmentStart[this->segment];
+    if (this->segmentStart[this->segment + 1] != first + 1 || first >= this->header->strings || this->stringLength[first] == 0 || this->base + this->stringLength[first] > this->header->bases) {
+        return false;
+    }
+
+    a.packed = (const WORD *) this->packed;
+    a.from = this->base;
+    a.length = this->stringLength[first];
+    this->takeRuns(a);
+    this->segment++;
+    this->base += a.length;
+
+    return true;
+}
+
+/**
+* Move to a segment, e.g. to search the text around a hit of an index. The
+* files hold no offsets of the bases of the segments, so the caller gives it.
+*
+* @param segment The index of the segment to read next
+* @param base The index of its first base
+* @return Do both lie in the file?
+*/
+bool BinaryEDS::seek(const uint64_t segment, const uint64_t base)
+{
+    if (this->header == NULL || segment > this->header->segments || base > this->header->bases) {
+        return false;
+    }
+
+    this->segment = segment;
+    this->base = base;
+    this->exception = (findRun((const WORD *) this->exceptions, this->header->exceptions, base) - (const WORD *) this->exceptions) / 2;
+    this->corrupt = false;
+
+    return true;
+}
+
+/**
+* Unpack any bases, wherever the next segment is
+*
+* @param from The index of the first base
+* @param to The index after the last base, at most the number of bases
+* @param out Set to the bases, Ns included
+*/
+void BinaryEDS::getBases(const uint64_t from, const uint64_t to, string & out) const
+{
+    out.resize(to - from);
+    if (to == from) {
+        return;
+    }
+    PackedView a;
+    a.packed = (const WORD *) this->packed;
+    a.from = from;
+    a.length = to - from;
+    a.exceptions = findRun((const WORD *) this->exceptions, this->header->exceptions, from);
+    a.n = 0;
+    while (a.exceptions + 2 * a.n < (const WORD *) this->exceptions + 2 * this->header->exceptions && a.exceptions[2 * a.n] < to) {
+        a.n++;
+    }
+    unpackView(a, &out[0]);
+}
+
+/**
+* Were all the segments read?
+*
+* @return false if reading stopped at an inconsistent table
+*/
+bool BinaryEDS::isComplete() const
+{
+    return this->header != NULL && !this->corrupt && this->segment == this->header->segments && this->base == this->header->bases;
+}
+
+/**
+* Get how far into the file the next segment is
+*
+* @return The offset of the word holding the first base of the next segment
+*/
+size_t BinaryEDS::getPosition() const
+{
+    if (this->header == NULL) {
+        return 0;
+    }
+    return (const char *) (this->packed + this->base / 32) - (const char *) this->header;
+}
+
+/**
+* Get the number of segments in the file
+*/
+uint64_t BinaryEDS::getSegments() const
+{
+    return this->header == NULL ? 0 : this->header->segments;
+}
+
+
+/**
+* Get the number of strings of all the segments
+*/
+uint64_t BinaryEDS::getStrings() const
+{
+    return this->header == NULL ? 0 : this->header->strings;
+}
+
+/**
+* Get the number of bases of all the strings
+*/
+uint64_t BinaryEDS::getBases() const
+{
+    return this->header == NULL ? 0 : this->header->bases;
+}
@@ -0,0 +1,220 @@
+/*
+    EDSM: Elastic Degenerate String Matching
+
+    Copyright (C) 2017 Chang Liu, Solon P. Pissis, Ahmad Retha and Fatima Vayani.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __BINARYEDS__
+#define __BINARYEDS__
+
+#include <cstdlib>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "edsm.hpp"
+#include "pipeline.hpp"
+
+#define BINARYEDSMAGIC "EDSMBIN2"
+
+/**
+ * The header of a binary EDS file. It is followed by four tables, in this
+ * order:
+ *
+ * segmentStart[segments + 1]  64 bits: the index of the first string of every segment
+ * packed[(bases + 31) / 32]   64 bits: the bases, 2 bits each, A = 0, C = 1, G = 2
+ *                             and T = 3, base i in bits 2 * (i % 32) of word i / 32
+ * exceptions[2 * exceptions]  64 bits: the runs of N bases, which are packed as A,
+ *                             each as the index of its first base and its number
+ *                             of bases, in increasing order
+ * stringLength[strings]       32 bits: the number of bases of every string
+ *
+ * The strings follow each other in packed, so a segment of strings holds the
+ * bases after those of the segment before it. A segment of one non-empty
+ * string is determinate and an empty string is epsilon. The words are little
+ * endian, as on x86-64.
+ */
+struct BinaryEDSHeader
+{
+    /**
+     * @var magic BINARYEDSMAGIC, without its terminating null
+     */
+    char magic[8];
+
+    /**
+     * @var segments The number of segments
+     */
+    uint64_t segments;
+
+    /**
+     * @var strings The number of strings of all the segments
+     */
+    uint64_t strings;
+
+    /**
+     * @var bases The number of bases of all the strings
+     */
+    uint64_t bases;
+
+    /**
+     * @var exceptions The number of runs of N bases
+     */
+    uint64_t exceptions;
+};
+
+/**
+ * Collects the segments of an elastic-degenerate text, e.g. parsed from EDS
+ * text or made from a reference and its variants, and writes them as a binary
+ * EDS file, about a quarter of the size of the text
+ */
+class BinaryEDSWriter : public SegmentSink
+{
+protected:
+
+    /**
+     * @var segmentStart The index of the first string of every segment, and the number of strings
+     */
+    std::vector<uint64_t> segmentStart;
+
+    /**
+     * @var packed The bases, 2 bits each
+     */
+    std::vector<uint64_t> packed;
+
+    /**
+     * @var exceptions The first base and the length of every run of N bases
+     */
+    std::vector<uint64_t> exceptions;
+
+    /**
+     * @var stringLength The number of bases of every string
+     */
+    std::vector<uint32_t> stringLength;
+
+    /**
+     * @var bases The number of bases appended
+     */
+    uint64_t bases;
+
+    BinaryEDSHeader getHeader() const;
+
+public:
+
+    BinaryEDSWriter();
+
+    void push(const StringView * S, const unsigned int n);
+
+    void push(const Segment & S);
+
+    bool save(const std::string & name) const;
+
+    size_t getImage(std::vector<uint64_t> & image) const;
+
+    uint64_t getSegments() const;
+
+    uint64_t getBases() const;
+
+};
+
+/**
+ * Reads the segments of a binary EDS file held in memory, typically a
+ * MappedFile, without any parsing: the tables are used in place and the
+ * strings of a segment are unpacked from 2 bits per base as they are read.
+ */
+class BinaryEDS
+{
+protected:
+
+    /**
+     * @var header The header of the file
+     */
+    const BinaryEDSHeader * header;
+
+    /**
+     * @var segmentStart The index of the first string of every segment
+     */
+    const uint64_t * segmentStart;
+
+    /**
+     * @var packed The bases, 2 bits each
+     */
+    const uint64_t * packed;
+
+    /**
+     * @var exceptions The first base and the length of every run of N bases
+     */
+    const uint64_t * exceptions;
+
+    /**
+     * @var stringLength The number of bases of every string
+     */
+    const uint32_t * stringLength;
+
+    /**
+     * @var segment The index of the next segment to read
+     */
+    uint64_t segment;
+
+    /**
+     * @var base The index of the first base of the next segment
+     */
+    uint64_t base;
+
+    /**
+     * @var exception The index of the first run of N bases that may lie in the next segment
+     */
+    uint64_t exception;
+
+    /**
+     * @var corrupt Was a table found to be inconsistent?
+     */
+    bool corrupt;
+
+    /**
+     * @var buffer The unpacked strings of the current segment
+     */
+    std::string buffer;
+
+    void unpack(const uint64_t from, const uint64_t to, char * out);
+
+    void takeRuns(PackedView & a);
+
+public:
+
+    BinaryEDS();
+
+    static bool isBinary(const char * t, const size_t n);
+
+    bool load(const char * t, const size_t n);
+
+    bool nextSegment(std::vector<StringView> & S);
+
+    bool nextPackedSegment(PackedView & a);
+
+    bool seek(const uint64_t segment, const uint64_t base);
+
+    void getBases(const uint64_t from, const uint64_t to, std::string & out) const;
+
+    bool isComplete() const;
+
+    size_t getPosition() const;
+
+    uint64_t getSegments() const;
+
+    uint64_t getStrings() const;
+
+    uint64_t getBases() const;
+
+};
+
+#endif
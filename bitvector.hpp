@@ -0,0 +1,517 @@
+/*
+    EDSM: Elastic Degenerate String Matching
+
+    Copyright (C) 2017 Chang Liu, Solon P. Pissis, Ahmad Retha and Fatima Vayani.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __BITVECTOR__
+#define __BITVECTOR__
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <new>
+
+#define WORD unsigned long int
+#define WORDSIZE (sizeof(WORD) * 8)
+
+/**
+ * The buffers freed by the dynamic bit-vectors of a thread, one list for each
+ * power of two of words, linked through their first word
+ */
+struct WordPool
+{
+    /**
+     * @var free The first free buffer of 2^i words for each i
+     */
+    WORD * free[64];
+
+    WordPool()
+    {
+        for (unsigned int i = 0; i < 64; i++) {
+            this->free[i] = NULL;
+        }
+    }
+
+    ~WordPool()
+    {
+        for (unsigned int i = 0; i < 64; i++)
+        {
+            while (this->free[i] != NULL)
+            {
+                WORD * p = this->free[i];
+                this->free[i] = (WORD *) *p;
+                ::operator delete(p);
+            }
+        }
+    }
+};
+
+/**
+ * Get the pool of the calling thread
+ */
+inline WordPool & wordPool()
+{
+    static thread_local WordPool pool;
+    return pool;
+}
+
+/**
+ * Allocates the words of dynamic bit-vectors from the pool of the thread, so
+ * the temporaries of a search reuse the buffers of the ones before them and
+ * only the first bit-vectors of each size go to the heap. Buffers are rounded
+ * up to a power of two of words and may be freed by another thread.
+ */
+template<class T>
+class WordAllocator
+{
+public:
+
+    typedef T value_type;
+
+    WordAllocator()
+    {
+    }
+
+    template<class U>
+    WordAllocator(const WordAllocator<U> &)
+    {
+    }
+
+    static unsigned int sizeClass(const size_t n)
+    {
+        unsigned int i = 0;
+        while ((1ul << i) * sizeof(WORD) < n * sizeof(T)) {
+            i++;
+        }
+        return i;
+    }
+
+    T * allocate(const size_t n)
+    {
+        WordPool & pool = wordPool();
+        const unsigned int i = sizeClass(n);
+        WORD * p = pool.free[i];
+        if (p != NULL)
+        {
+            pool.free[i] = (WORD *) *p;
+            return (T *) p;
+        }
+        return (T *) ::operator new((1ul << i) * sizeof(WORD));
+    }
+
+    void deallocate(T * p, const size_t n)
+    {
+        WordPool & pool = wordPool();
+        const unsigned int i = sizeClass(n);
+        *(WORD *) p = (WORD) pool.free[i];
+        pool.free[i] = (WORD *) p;
+    }
+
+    template<class U>
+    bool operator==(const WordAllocator<U> &) const
+    {
+        return true;
+    }
+
+    template<class U>
+    bool operator!=(const WordAllocator<U> &) const
+    {
+        return false;
+    }
+};
+
+/**
+ * A bit-vector of N machine words used to hold the search state of patterns
+ * longer than a single word. Bit 0 is the lowest bit of w[0].
+ *
+ * Only the operations required by EDSM-BV are provided: and, or, shifts by
+ * any amount, and setting/resetting/testing single bits.
+ */
+template<unsigned int N>
+class BitVector
+{
+public:
+
+    /**
+     * @var w The words of the bit-vector, least significant first
+     */
+    WORD w[N];
+
+    BitVector()
+    {
+        this->clear();
+    }
+
+    void clear()
+    {
+        for (unsigned int i = 0; i < N; i++) {
+            this->w[i] = 0;
+        }
+    }
+
+    void set(const unsigned int i)
+    {
+        this->w[i / WORDSIZE] |= 1ul << (i % WORDSIZE);
+    }
+
+    void reset(const unsigned int i)
+    {
+        this->w[i / WORDSIZE] &= ~(1ul << (i % WORDSIZE));
+    }
+
+    bool test(const unsigned int i) const
+    {
+        return (this->w[i / WORDSIZE] >> (i % WORDSIZE)) & 1ul;
+    }
+
+    bool any() const
+    {
+        WORD x = 0;
+        for (unsigned int i = 0; i < N; i++) {
+            x |= this->w[i];
+        }
+        return x != 0;
+    }
+
+    BitVector & operator&=(const BitVector & b)
+    {
+        for (unsigned int i = 0; i < N; i++) {
+            this->w[i] &= b.w[i];
+        }
+        return *this;
+    }
+
+    BitVector & operator|=(const BitVector & b)
+    {
+        for (unsigned int i = 0; i < N; i++) {
+            this->w[i] |= b.w[i];
+        }
+        return *this;
+    }
+
+    BitVector & operator>>=(const unsigned int k)
+    {
+        const unsigned int ws = k / WORDSIZE, bs = k % WORDSIZE;
+        unsigned int i;
+        for (i = 0; i + ws < N; i++)
+        {
+            this->w[i] = this->w[i + ws] >> bs;
+            if (bs > 0 && i + ws + 1 < N) {
+                this->w[i] |= this->w[i + ws + 1] << (WORDSIZE - bs);
+            }
+        }
+        for (; i < N; i++) {
+            this->w[i] = 0;
+        }
+        return *this;
+    }
+
+    BitVector & operator<<=(const unsigned int k)
+    {
+        const unsigned int ws = k / WORDSIZE, bs = k % WORDSIZE;
+        int i;
+        for (i = N - 1; i >= (int)ws; i--)
+        {
+            this->w[i] = this->w[i - ws] << bs;
+            if (bs > 0 && i - (int)ws - 1 >= 0) {
+                this->w[i] |= this->w[i - ws - 1] >> (WORDSIZE - bs);
+            }
+        }
+        for (; i >= 0; i--) {
+            this->w[i] = 0;
+        }
+        return *this;
+    }
+
+    BitVector operator&(const BitVector & b) const
+    {
+        BitVector r = *this;
+        return r &= b;
+    }
+
+    BitVector operator|(const BitVector & b) const
+    {
+        BitVector r = *this;
+        return r |= b;
+    }
+
+    BitVector operator>>(const unsigned int k) const
+    {
+        BitVector r = *this;
+        return r >>= k;
+    }
+
+    BitVector operator<<(const unsigned int k) const
+    {
+        BitVector r = *this;
+        return r <<= k;
+    }
+
+    bool operator==(const BitVector & b) const
+    {
+        for (unsigned int i = 0; i < N; i++) {
+            if (this->w[i] != b.w[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+/**
+ * The single word case is kept as plain word operations so that short patterns
+ * run exactly as fast as they did before multi-word support was added.
+ */
+template<>
+class BitVector<1>
+{
+public:
+
+    WORD w[1];
+
+    BitVector()
+    {
+        this->w[0] = 0;
+    }
+
+    void clear()
+    {
+        this->w[0] = 0;
+    }
+
+    void set(const unsigned int i)
+    {
+        this->w[0] |= 1ul << i;
+    }
+
+    void reset(const unsigned int i)
+    {
+        this->w[0] &= ~(1ul << i);
+    }
+
+    bool test(const unsigned int i) const
+    {
+        return (this->w[0] >> i) & 1ul;
+    }
+
+    bool any() const
+    {
+        return this->w[0] != 0;
+    }
+
+    BitVector & operator&=(const BitVector & b)
+    {
+        this->w[0] &= b.w[0];
+        return *this;
+    }
+
+    BitVector & operator|=(const BitVector & b)
+    {
+        this->w[0] |= b.w[0];
+        return *this;
+    }
+
+    BitVector & operator>>=(const unsigned int k)
+    {
+        this->w[0] = (k < WORDSIZE) ? (this->w[0] >> k) : 0;
+        return *this;
+    }
+
+    BitVector & operator<<=(const unsigned int k)
+    {
+        this->w[0] = (k < WORDSIZE) ? (this->w[0] << k) : 0;
+        return *this;
+    }
+
+    BitVector operator&(const BitVector & b) const
+    {
+        BitVector r = *this;
+        return r &= b;
+    }
+
+    BitVector operator|(const BitVector & b) const
+    {
+        BitVector r = *this;
+        return r |= b;
+    }
+
+    BitVector operator>>(const unsigned int k) const
+    {
+        BitVector r = *this;
+        return r >>= k;
+    }
+
+    BitVector operator<<(const unsigned int k) const
+    {
+        BitVector r = *this;
+        return r <<= k;
+    }
+
+    bool operator==(const BitVector & b) const
+    {
+        return this->w[0] == b.w[0];
+    }
+};
+
+/**
+ * The dynamic fallback for patterns longer than the largest fixed size. The
+ * number of words grows as bits are set; missing words are treated as zero.
+ * The words come from the WordPool of the thread.
+ */
+template<>
+class BitVector<0>
+{
+public:
+
+    std::vector< WORD, WordAllocator<WORD> > w;
+
+    void clear()
+    {
+        this->w.assign(this->w.size(), 0ul);
+    }
+
+    void set(const unsigned int i)
+    {
+        if (i / WORDSIZE >= this->w.size()) {
+            this->w.resize(i / WORDSIZE + 1, 0ul);
+        }
+        this->w[i / WORDSIZE] |= 1ul << (i % WORDSIZE);
+    }
+
+    void reset(const unsigned int i)
+    {
+        if (i / WORDSIZE < this->w.size()) {
+            this->w[i / WORDSIZE] &= ~(1ul << (i % WORDSIZE));
+        }
+    }
+
+    bool test(const unsigned int i) const
+    {
+        if (i / WORDSIZE >= this->w.size()) {
+            return false;
+        }
+        return (this->w[i / WORDSIZE] >> (i % WORDSIZE)) & 1ul;
+    }
+
+    bool any() const
+    {
+        for (unsigned int i = 0; i < this->w.size(); i++) {
+            if (this->w[i] != 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    BitVector & operator&=(const BitVector & b)
+    {
+        if (b.w.size() < this->w.size()) {
+            this->w.resize(b.w.size());
+        }
+        for (unsigned int i = 0; i < this->w.size(); i++) {
+            this->w[i] &= b.w[i];
+        }
+        return *this;
+    }
+
+    BitVector & operator|=(const BitVector & b)
+    {
+        if (b.w.size() > this->w.size()) {
+            this->w.resize(b.w.size(), 0ul);
+        }
+        for (unsigned int i = 0; i < b.w.size(); i++) {
+            this->w[i] |= b.w[i];
+        }
+        return *this;
+    }
+
+    BitVector & operator>>=(const unsigned int k)
+    {
+        const unsigned int ws = k / WORDSIZE, bs = k % WORDSIZE;
+        const unsigned int n = this->w.size();
+        unsigned int i;
+        for (i = 0; i + ws < n; i++)
+        {
+            this->w[i] = this->w[i + ws] >> bs;
+            if (bs > 0 && i + ws + 1 < n) {
+                this->w[i] |= this->w[i + ws + 1] << (WORDSIZE - bs);
+            }
+        }
+        for (; i < n; i++) {
+            this->w[i] = 0;
+        }
+        return *this;
+    }
+
+    BitVector & operator<<=(const unsigned int k)
+    {
+        const unsigned int ws = k / WORDSIZE, bs = k % WORDSIZE;
+        if (this->w.size() == 0) {
+            return *this;
+        }
+        this->w.resize(this->w.size() + ws + 1, 0ul);
+        int i;
+        for (i = this->w.size() - 1; i >= (int)ws; i--)
+        {
+            this->w[i] = this->w[i - ws] << bs;
+            if (bs > 0 && i - (int)ws - 1 >= 0) {
+                this->w[i] |= this->w[i - ws - 1] >> (WORDSIZE - bs);
+            }
+        }
+        for (; i >= 0; i--) {
+            this->w[i] = 0;
+        }
+        return *this;
+    }
+
+    BitVector operator&(const BitVector & b) const
+    {
+        BitVector r = *this;
+        return r &= b;
+    }
+
+    BitVector operator|(const BitVector & b) const
+    {
+        BitVector r = *this;
+        return r |= b;
+    }
+
+    BitVector operator>>(const unsigned int k) const
+    {
+        BitVector r = *this;
+        return r >>= k;
+    }
+
+    BitVector operator<<(const unsigned int k) const
+    {
+        BitVector r = *this;
+        return r <<= k;
+    }
+
+    bool operator==(const BitVector & b) const
+    {
+        const unsigned int n = std::max(this->w.size(), b.w.size());
+        for (unsigned int i = 0; i < n; i++) {
+            if ((i < this->w.size() ? this->w[i] : 0ul) != (i < b.w.size() ? b.w[i] : 0ul)) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+typedef BitVector<0> DynamicBitVector;
+
+#endif
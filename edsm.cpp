@@ -17,289 +17,374 @@
 
 #include <iostream>
 #include <cstdlib>
+#include <cstring>
 #include <string>
 #include <vector>
 #include <ctime>
-#include <divsufsort64.h>
-#include <sdsl/bit_vectors.hpp>
-#include <sdsl/suffix_trees.hpp>
+#include <type_traits>
+#include <memory>
 #include "edsm.hpp"
+#include "allocations.hpp"
 
-using namespace sdsl;
 using namespace std;
 
 /**
-* @constructor
-*/
-EDSM::EDSM()
-{
-    this->m = 0;
-    this->B = 0;
-    this->f = 0;
-    this->F = 0;
-    this->d = 0;
-    this->D = 0;
-    this->Np = 0;
-    this->Nm = 0;
-    this->pos = 0;
-    this->duration = 0;
-    this->kmpBT = NULL;
-    this->primed = false;
-    this->chr2idx[(int)'N'] = 0;
-    this->chr2idx[(int)'A'] = 1;
-    this->chr2idx[(int)'C'] = 2;
-    this->chr2idx[(int)'G'] = 3;
-    this->chr2idx[(int)'T'] = 4;
-}
-
-/**
-* The constructor can be given a pattern
+* The processor time used by the calling thread, so the time of EDSM-BV is not
+* mixed up with that of the threads reading and parsing the input
 *
-* @constructor
-* @param P The determinate pattern string to search the segments for
+* @return The time in seconds
 */
-EDSM::EDSM(const string & P) : EDSM()
+static double threadTime()
 {
-    this->setPattern(P);
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
 }
 
 /**
-* @destructor
+* Turn a packed string into characters, N bases included
+*
+* @param a The packed string
+* @param out Where the a.length characters are written
 */
-EDSM::~EDSM()
+void unpackView(const PackedView & a, char * out)
 {
-    if (this->kmpBT != NULL) {
-        delete [] this->kmpBT;
+    unpackBases(a.packed, a.from, a.length, out);
+    for (unsigned int k = 0; k < a.n; k++)
+    {
+        size_t first = max((size_t) a.exceptions[2 * k], a.from);
+        size_t last = min((size_t) (a.exceptions[2 * k] + a.exceptions[2 * k + 1]), a.from + a.length);
+        if (last > first) {
+            memset(out + (first - a.from), 'N', last - first);
+        }
     }
 }
 
 /**
-* Set the pattern to search for
+* Find the first run of N bases that ends after a base
 *
-* @param P A determinate pattern consisting of A, C, G or T characters
+* @param runs The runs, each as its first base and its number of bases, in increasing order
+* @param n The number of runs
+* @param base The index of the base
+* @return The run, or the end of runs if none ends after base
 */
-void EDSM::setPattern(const string & P)
+const WORD * findRun(const WORD * runs, const size_t n, const uint64_t base)
 {
-    clock_t start = clock();
-
-    if (P.length() == 0)
-    {
-        cerr << "Error: Pattern length 0! Aborting!" << endl;
-        return;
-    }
-    else if (P.length() > WORDSIZE)
-    {
-        cerr << "Error: Pattern length greater than word size (" << WORDSIZE << ")! Aborting!" << endl;
-        return;
-    }
-    unsigned int j;
-    for (j = 0; j < P.length(); j++) {
-        if (!(P[j] == 'A' || P[j] == 'C' || P[j] == 'G' || P[j] == 'T')) {
-            cerr << "Error: Invalid character in pattern: '" << P[j] << "'!" << endl;
-            return;
-        }
-    }
-    this->P = P;
-    this->m = j;
-
-    //reset search state
-    this->primed = false;
-    this->d = 0;
-    this->D = 0;
-
-    //construct the border table for the KMP search
-    this->constructKMPBT();
-
-    //initialize I bitvector by first clearing it then filling it with positions of P characters
-    for (j = 0; j < 5ul; j++) {
-        I[j] = 0;
-    }
-    for (j = 0; j < this->m; j++)
+    size_t low = 0, high = n, mid;
+    while (low < high)
     {
-        if (this->chr2idx[(int)this->P[j]] > 0) {
-            this->I[this->chr2idx[(int)this->P[j]]] = this->I[this->chr2idx[(int)this->P[j]]] | (1ul << (this->m - j));
+        mid = low + (high - low) / 2;
+        if (runs[2 * mid] + runs[2 * mid + 1] <= base) {
+            low = mid + 1;
+        } else {
+            high = mid;
         }
     }
-
-    //construct the suffix tree of P
-    construct_im(this->STp, this->P.c_str(), sizeof(char));
-
-    //create occVector tool / data structure
-    this->constructOV();
-
-    this->duration += clock() - start;
+    return runs + 2 * low;
 }
 
 /**
- * Construct the occVector tool / data structure and assign memory
- */
-void EDSM::constructOV()
+* @constructor
+* @param ids The indexes of the patterns held by the engine
+*/
+EDSMEngine::EDSMEngine(const vector<unsigned int> & ids)
 {
-    this->OVMem.clear();
-    this->OVMem.assign(this->STp.nodes(), 0ul);
-    this->recAssignOVMem(this->STp.root());
+    this->ids = ids;
+    this->Np = 0;
+    this->Nm = 0;
+    this->chr2idx[(int)'N'] = 0;
+    this->chr2idx[(int)'A'] = 1;
+    this->chr2idx[(int)'C'] = 2;
+    this->chr2idx[(int)'G'] = 3;
+    this->chr2idx[(int)'T'] = 4;
 }
 
 /**
- * Recursively traverse the Suffix Tree of P and work out its occVector encoding,
- * combine if necessary, and store in occVector memory structure
- *
- * @param u A node in STp
- * @return The encoded positions of substrings
- */
-WORD EDSM::recAssignOVMem(const node_t & u)
+* @destructor
+*/
+EDSMEngine::~EDSMEngine()
 {
-    int id = this->STp.id(u);
-
-    if (this->STp.is_leaf(u))
-    {
-        this->OVMem[id] = 1ul << ((int)this->m - this->STp.sn(u)); //sn(u) gets the suffix index from leaf node u
-    }
-    else
-    {
-        for (const auto & child : this->STp.children(u)) {
-            this->OVMem[id] = this->OVMem[id] | this->recAssignOVMem(child);
-        }
-    }
-
-    return this->OVMem[id];
 }
 
 /**
-* Construct the border table of P for the KMP search
+* Search a determinate segment of packed bases. Engines without kernels for
+* packed bases search its characters instead.
+*
+* @param a The segment, not empty
+* @param pos The position of a in the text
+* @return Match Found or not
 */
-void EDSM::constructKMPBT()
+bool EDSMEngine::searchPackedSegment(const PackedView & a, const unsigned int pos)
 {
-    if (this->kmpBT != NULL)
-    {
-        delete [] this->kmpBT;
-    }
-
-    this->kmpBT = new int[this->m];
-    this->kmpBT[0] = -1;
-    int i, j;
-    for (i = 1; i < (int)this->m; i++)
-    {
-        j = this->kmpBT[i - 1];
-        while (j >= 0)
-        {
-            if (this->P[j] == this->P[i - 1])
-            {
-                break;
-            }
-            else
-            {
-                j = this->kmpBT[j];
-            }
-        }
-        this->kmpBT[i] = j + 1;
-    }
+    StringView s;
+    this->unpacked.resize(a.length);
+    unpackView(a, &this->unpacked[0]);
+    s.data = this->unpacked.data();
+    s.length = a.length;
+    return this->searchNextSegment(&s, 1, true, pos);
 }
 
 /**
-* Get a list of the positions of matches found.
+* Get the matches found by the engine since they were last collected
 *
-* @return A vector of ints of the position numbers where matches were found
+* @return A reference to the vector of match positions
 */
-vector<int> EDSM::getMatches() const
+vector<int> & EDSMEngine::getMatches()
 {
     return this->matches;
 }
 
 /**
-* Clear the matches list
+* Get the pattern indexes of the matches found since they were last collected
+*
+* @return A reference to the vector of pattern indexes, parallel to getMatches()
 */
-void EDSM::clearMatches()
+vector<unsigned int> & EDSMEngine::getMatchPatterns()
 {
-    this->matches.clear();
+    return this->matchPatterns;
 }
 
 /**
-* Get the total number of determinate segments searched so far
+* Get the total number of strings analyzed that are shorter than m
 */
-unsigned int EDSM::getd() const
+unsigned int EDSMEngine::getNp() const
 {
-    return this->d;
+    return this->Np;
 }
 
 /**
-* Get the total number of degenerate segments searched so far
+* Get the total length of the strings analyzed that are shorter than m
 */
-unsigned int EDSM::getD() const
+unsigned int EDSMEngine::getNm() const
 {
-    return this->D;
+    return this->Nm;
 }
 
 /**
-* Get the total length of determinate segments searched so far
+* Set the state of the search to what it is after a determinate string a
+* ending at pos. The state only depends on the last m characters read (the
+* prefixes of P they end with and whether P itself just ended), so a search
+* started from the m characters before a cut in the text carries on exactly as
+* one that read everything before it. Nothing found in a is reported or counted.
+*
+* @param a The characters before the cut
+* @param pos The position of a in the text
 */
-unsigned int EDSM::getf() const
+void EDSMEngine::prime(const StringView & a, const unsigned int pos)
 {
-    return this->f;
+    unsigned int Np = this->Np, Nm = this->Nm;
+
+    this->reset();
+    if (a.length > 0) {
+        this->searchNextSegment(&a, 1, true, pos);
+    }
+    this->matches.clear();
+    this->matchPatterns.clear();
+    this->Np = Np;
+    this->Nm = Nm;
 }
 
 /**
-* Get the total length of degenerate segments searched so far
+* Add the counters of another engine for the same patterns, e.g. one that
+* searched another part of the text
+*
+* @param other The other engine
 */
-unsigned int EDSM::getF() const
+void EDSMEngine::addCounters(const EDSMEngine & other)
 {
-    return this->F;
+    this->Np += other.Np;
+    this->Nm += other.Nm;
 }
 
 /**
-* Get the total number of strings analyzed that are shorter than m
+* Make sure the scratch buffers can hold n characters and n border table
+* entries. Buffers at least double when they grow, so once the largest segment
+* has been seen no more memory is allocated.
+*
+* @param n The number of entries needed
 */
-unsigned int EDSM::getNp() const
+void EDSMEngine::reserveScratch(const unsigned int n)
 {
-    return this->Np;
+    if (this->scratchText.capacity() < n)
+    {
+        this->scratchText.reserve(max((size_t) n, 2 * this->scratchText.capacity()));
+    }
+    if (this->scratchBT.size() < n)
+    {
+        this->scratchBT.resize(max((size_t) n, 2 * this->scratchBT.size()));
+    }
 }
 
 /**
-* Get the total length of the strings analyzed that are shorter than m
+* Report a match
+*
+* NOTE: We do not report the index of the match currently... no reason to.
+*
+* @param s The segment it was discovered in
+* @param i The index of the match
+* @param k The pattern of the engine that matched
 */
-unsigned int EDSM::getNm() const
+void EDSMEngine::report(const int s, const int i, const unsigned int k)
 {
-    return this->Nm;
+    this->matches.push_back(s);
+    this->matchPatterns.push_back(this->ids[k]);
 }
 
 /**
-* Returns the execution duration of EDSM-BV in seconds
+* Compile the pattern: build the I bit-vectors and the suffix automaton of P,
+* with the occVector table of its short substrings
+*
+* @constructor
+* @param P A determinate pattern consisting of A, C, G or T characters
+* @param id The index of the pattern
+* @param occTableLength The length of the longest strings whose occVector is precomputed
 */
-double EDSM::getDuration() const
+template<class BV>
+EDSMBV<BV>::EDSMBV(const string & P, const unsigned int id, const unsigned int occTableLength) : EDSMEngine(vector<unsigned int>(1, id))
 {
-    return this->duration / (double) CLOCKS_PER_SEC;
+    unsigned int j;
+
+    this->P = P;
+    this->m = P.length();
+
+    //construct the border table for the KMP search
+    this->constructKMPBT();
+
+    //initialize I bitvector with positions of P characters
+    for (j = 0; j < this->m; j++)
+    {
+        if (this->chr2idx[(int)this->P[j]] > 0) {
+            this->I[this->chr2idx[(int)this->P[j]]].set(this->m - j);
+        }
+    }
+
+    this->PB[this->chr2idx[(int)this->P[0]]].set(this->m - 1);
+
+    //the transition table of the vector kernels, indexed directly by character;
+    //their state is a single word
+    this->useStripes = this->m < WORDSIZE && is_same< BV, BitVector<1> >::value;
+    for (j = 0; j < 256; j++) {
+        this->stripeMask[j] = 0;
+    }
+    if (this->useStripes)
+    {
+        for (j = 0; j < this->m; j++) {
+            this->stripeMask[(unsigned char)this->P[j]] |= 1ul << (this->m - j);
+        }
+        this->stripeStart = 1ul << this->m;
+        const KernelSet & kernels = getKernels();
+        this->stripeKernel = kernels.stripes;
+        this->stripeLanes = kernels.lanes;
+        this->alleleKernel = kernels.alleles;
+        this->packedStripeKernel = kernels.packedStripes;
+    }
+    for (j = 0; j < 4; j++) {
+        this->packedMask[j] = this->stripeMask[(unsigned char)"ACGT"[j]];
+    }
+
+    //the masks of the backward scan, bit m - 1 - j in bndmMask[c] when P[j] = c. A
+    //vectorized striped kernel is faster than BNDM unless P is long enough for
+    //the backward scan to skip most of the text
+    this->useBNDM = this->m >= BNDMMINLENGTH && this->m <= WORDSIZE;
+    if (this->useStripes && this->stripeKernel != shiftAndStripesScalar && this->m < STRIPEBNDMLENGTH) {
+        this->useBNDM = false;
+    }
+    for (j = 0; j < 5; j++) {
+        this->bndmMask[j] = 0;
+    }
+    if (this->useBNDM)
+    {
+        for (j = 0; j < this->m; j++) {
+            this->bndmMask[this->chr2idx[(int)this->P[j]]] |= 1ul << (this->m - 1 - j);
+        }
+    }
+
+    //construct the suffix automaton of P, the occVector tool / data structure
+    PatternIndex<BV> * SAp = new PatternIndex<BV>();
+    SAp->build(this->P, occTableLength);
+    this->SAp.reset(SAp);
 }
 
 /**
-* Finds a node u (explicitNode) in the STp where (a) is a substring of (P), then
-* proceeds to encode the children of u into a bit-vector (M).
-*
-* @param a The substring to find in P
-* @return A bit-vector
+* Construct the border table of P for the KMP search
 */
-WORD EDSM::occVector(const string & a)
+template<class BV>
+void EDSMBV<BV>::constructKMPBT()
 {
-    node_t explicitNode = this->STp.root();
-    string::const_iterator it;
-    uint64_t char_pos = 0;
-    unsigned int j = 0;
-    for (it = a.begin(); it != a.end(); ++it)
+    vector<int> * kmpBT = new vector<int>(this->m);
+    (*kmpBT)[0] = -1;
+    int i, j;
+    for (i = 1; i < (int)this->m; i++)
     {
-        if (forward_search(this->STp, explicitNode, it - a.begin(), *it, char_pos) > 0) {
-            j++;
-        } else {
-            break;
+        j = (*kmpBT)[i - 1];
+        while (j >= 0)
+        {
+            if (this->P[j] == this->P[i - 1])
+            {
+                break;
+            }
+            else
+            {
+                j = (*kmpBT)[j];
+            }
         }
+        (*kmpBT)[i] = j + 1;
     }
+    this->kmpBT.reset(kmpBT);
+}
+
+/**
+* KMP search
+*
+* @param needle The pattern being searched for
+* @param haystack The sequence that we are searching in
+* @param B The border table of the needle
+* @param i The starting position in the haystack from which to start searching from
+* @return -1 if the needle is not found or the index of the last character of the needle found in the haystack
+*/
+template<class BV>
+int EDSMBV<BV>::KMP(const string & needle, const StringView & haystack, const int * B, int i)
+{
+    int m, n;
+    m = needle.length();
+    n = haystack.length;
 
-    //if a is present in p
-    if (j == a.length())
+    int j = 0;
+    while (i < n)
     {
-        int id = this->STp.id(explicitNode);
-        return this->OVMem[id];
+        if (j == -1)
+        {
+            j = 0;
+            i++;
+        }
+        else if (haystack.data[i] == needle[j])
+        {
+            j++;
+            if (j == m) {
+                return i;
+            }
+            i++;
+        }
+        else
+        {
+            j = B[j];
+        }
     }
 
-    return 0;
+    return -1;
+}
+
+/**
+* Finds the state of the suffix automaton of P reached by reading (a), then
+* returns its encoding of the positions of (a) in P as a bit-vector (M).
+*
+* @param a The substring to find in P
+* @return A bit-vector, empty if a is not a substring of P
+*/
+template<class BV>
+BV EDSMBV<BV>::occVector(const StringView & a)
+{
+    return this->SAp->occVector(a.data, a.length);
 }
 
 /**
@@ -308,33 +393,44 @@ WORD EDSM::occVector(const string & a)
 * TODO: there's likely a better more memory efficient way to code this
 *
 * @param S A segment (contains one or more strings)
+* @param n The number of strings in S
 * @return Border table bit-vector representation
 */
-WORD EDSM::computePrefixBorderTable(const Segment & S)
+template<class BV>
+BV EDSMBV<BV>::computePrefixBorderTable(const StringView * S, const unsigned int n)
 {
-    unsigned int i, km;
+    unsigned int i, s, km;
     int j, h;
-    Segment::const_iterator s;
 
-    string k = this->P + "_";
-    for (s = S.begin(); s != S.end(); ++s) {
-        if ((*s).length() > 0) {
-            if ((*s).length() >= this->m) {
-                k += (*s).substr((*s).length() - this->m + 1);
+    //size the scratch buffers for the concatenation of P, '_' and the strings of S
+    km = this->m + 1;
+    for (s = 0; s < n; s++) {
+        if (S[s].length > 0) {
+            km += min(S[s].length, this->m - 1) + 1;
+        }
+    }
+    this->reserveScratch(km);
+
+    string & k = this->scratchText;
+    k.assign(this->P);
+    k += '_';
+    for (s = 0; s < n; s++) {
+        if (S[s].length > 0) {
+            if (S[s].length >= this->m) {
+                k.append(S[s].data + S[s].length - this->m + 1, this->m - 1);
             } else {
-                k += *s;
+                k.append(S[s].data, S[s].length);
             }
             k += '#';
         }
     }
 
-    km = k.length();
-    int * BT = new int[km];
+    int * BT = &this->scratchBT[0];
 
     //BT[0] = 0;
     for (j = 1; j < (int)this->m; j++)
     {
-        BT[j - 1] = this->kmpBT[j];
+        BT[j - 1] = (*this->kmpBT)[j];
     }
     BT[j - 1] = 0;
 
@@ -350,30 +446,27 @@ WORD EDSM::computePrefixBorderTable(const Segment & S)
     BT[km - 1] = j;
 
     //See Example 12 in the paper. This is based on KMP algorithm.
-    WORD B = 0;
+    BV B;
     j = (int)this->m;
-    for (s = S.begin(); s != S.end(); ++s)
+    for (s = 0; s < n; s++)
     {
-        if ((*s).length() >= this->m) {
-            j += 1 + (*s).length() - ((*s).length() - (int)this->m + 1);
-        } else {
-            j += 1 + (*s).length();
+        if (S[s].length == 0) {
+            continue;
         }
+        j += 1 + min(S[s].length, this->m - 1);
         if (BT[j - 1] > 0) {
-            B = B | (1ul << -(BT[j - 1] - (int)this->m));
+            B.set((int)this->m - BT[j - 1]);
             for (h = BT[j - 1] - 1; BT[h] > 0; h = BT[h - 1]) {
-                B = B | (1ul << -(BT[h] - (int)this->m));
+                B.set((int)this->m - BT[h]);
             }
         }
     }
 
-    delete [] BT;
-
     return B;
 }
 
 /**
-* @deprecated Because EDSM::computePrefixBorderTable() has better Big O complexity
+* @deprecated Because EDSMBV::computePrefixBorderTable() has better Big O complexity
 * (linear). This method is sometimes faster in practice but it has quadratic time
 * complexity.
 *
@@ -381,19 +474,21 @@ WORD EDSM::computePrefixBorderTable(const Segment & S)
 * matching prefixes of the pattern in the suffix of the strings.
 *
 * @param S A segment
+* @param n The number of strings in S
 * @return A bitvector representing matches of prefix of P
 */
-WORD EDSM::computeSegmentPrefixMatches(const Segment & S)
+template<class BV>
+BV EDSMBV<BV>::computeSegmentPrefixMatches(const StringView * S, const unsigned int n)
 {
     int i, j, m;
-    WORD B = 0;
+    unsigned int s;
+    BV B;
 
-    Segment::const_iterator s;
-    for (s = S.begin(); s != S.end(); ++s) {
-        if (*s == EPSILON) {
+    for (s = 0; s < n; s++) {
+        if (S[s].length == 0) {
             continue;
         }
-        m = (*s).length();
+        m = S[s].length;
         if (m >= (int)this->m) {
             i = m - (int)this->m + 1;
         } else {
@@ -402,10 +497,10 @@ WORD EDSM::computeSegmentPrefixMatches(const Segment & S)
         while (i < m)
         {
             j = 0;
-            while (i + j < m && this->P[j] == (*s)[i + j])
+            while (i + j < m && this->P[j] == S[s].data[i + j])
             {
                 if (i + j == m - 1) {
-                    B = B | (1ul << -(j + 1 - (int)this->m));
+                    B.set((int)this->m - (j + 1));
                 }
                 j++;
             }
@@ -417,228 +512,1654 @@ WORD EDSM::computeSegmentPrefixMatches(const Segment & S)
 }
 
 /**
-* KMP search
+* Search a degenerate segment whose strings are all single characters (SNPs)
 *
-* @param needle The pattern being searched for
-* @param haystack The sequence that we are searching in
-* @param B The border table of the needle
-* @param i The starting position in the haystack from which to start searching from
-* @return -1 if the needle is not found or the index of the last character of the needle found in the haystack
+* For such a segment the border table, KMP and occVector all reduce to the
+* I and PB bit-vectors of the characters: the new state is the OR over the
+* alleles c of ((B & I[c]) >> 1) | PB[c], plus B for the empty string. The
+* masks of the alleles are OR-ed first so the state is updated only once.
+* The result is identical to the general case.
+*
+* @param S The next segment
+* @param n The number of strings in S
+* @param pos The position of S in the text
+* @param matchFound Set to whether P was found
+* @return Was S handled, i.e. is every string of S a single character?
 */
-int EDSM::KMP(const string & needle, const string & haystack, int * B, int i)
+template<class BV>
+bool EDSMBV<BV>::searchSNPSegment(const StringView * S, const unsigned int n, const unsigned int pos, bool & matchFound)
 {
-    int m, n;
-    m = needle.length();
-    n = haystack.length();
+    BV Ia, PBa, B1;
+    unsigned int s, alleles = 0;
+    bool epsilon = false;
 
-    int j = 0;
-    while (i < n)
+    if (this->m < 2) {
+        return false;
+    }
+
+    for (s = 0; s < n; s++)
     {
-        if (j == -1)
+        if (S[s].length == 0)
         {
-            j = 0;
-            i++;
+            epsilon = true;
+            continue;
         }
-        else if (haystack[i] == needle[j])
-        {
-            j++;
-            if (j == m) {
-                return i;
-            }
-            i++;
+        if (S[s].length != 1) {
+            return false;
         }
-        else
+        Ia |= this->I[this->chr2idx[(int)S[s].data[0]]];
+        PBa |= this->PB[this->chr2idx[(int)S[s].data[0]]];
+        alleles++;
+    }
+
+    B1 = (this->B & Ia) >> 1;
+    matchFound = B1.test(0);
+    if (matchFound) {
+        this->report((int)pos, 0);
+    }
+    if (this->B.any())
+    {
+        this->Np += alleles;
+        this->Nm += alleles;
+    }
+    B1 |= PBa;
+    if (epsilon) {
+        B1 |= this->B;
+    }
+    this->B = B1;
+
+    return true;
+}
+
+/**
+* Find the occurrences of P inside a with BNDM. Each window of m characters is
+* read backwards while some factor of P is still recognised, so on average far
+* fewer than |a| characters are looked at and the window can move up to m
+* characters at once. Only used when P fits a single word.
+*
+* @param a The determinate string
+* @param pos The position of a in the text
+* @return Match Found or not
+*/
+template<class BV>
+bool EDSMBV<BV>::searchBNDM(const StringView & a, const unsigned int pos)
+{
+    const WORD top = 1ul << (this->m - 1);
+    unsigned int w = 0, j, last;
+    WORD D;
+    bool matchFound = false;
+
+    while (w + this->m <= a.length)
+    {
+        j = this->m;
+        last = this->m;
+        D = ~0ul;
+        while (j > 0 && D != 0)
         {
-            j = B[j];
+            D &= this->bndmMask[this->chr2idx[(int)a.data[w + j - 1]]];
+            j--;
+            if (D & top)
+            {
+                //a[w + j..w + m) is a prefix of P, or all of it
+                if (j > 0) {
+                    last = j;
+                } else {
+                    this->report((int)(pos + w + this->m - 1), (int)(w + this->m - 1));
+                    matchFound = true;
+                }
+            }
+            D <<= 1;
         }
+        w += last;
     }
 
-    return -1;
+    return matchFound;
 }
 
 /**
-* Report a match
-*
-* NOTE: We do not report the index of the match currently... no reason to.
+* Find the occurrences of P inside a with the striped Shift-And kernel. The
+* string is cut into one stripe per lane, each stripe overlapping the previous
+* one by m - 1 characters, and the hits of the lanes are reported lane by lane,
+* which is position order. The few characters left over after the last stripe
+* are not searched.
 *
-* @param s The segment it was discovered in
-* @param i The index of the match
+* @param a The determinate string
+* @param pos The position of a in the text
+* @param matchFound Set to true if P was found
+* @return The end of the searched part: occurrences ending at m - 1 up to here were reported
 */
-void EDSM::report(const int s, const int i)
+template<class BV>
+unsigned int EDSMBV<BV>::searchStripes(const StringView & a, const unsigned int pos, bool & matchFound)
 {
-    this->matches.push_back(s);
+    const unsigned int stride = (a.length - this->m + 1) / this->stripeLanes;
+    unsigned int k, h;
+
+    this->stripeKernel(this->stripeMask, this->stripeStart, a.data, stride, stride + this->m - 1, this->laneHits);
+
+    for (k = 0; k < this->stripeLanes; k++)
+    {
+        for (h = 0; h < this->laneHits[k].size(); h++)
+        {
+            this->report((int)(pos + this->laneHits[k][h]), (int)this->laneHits[k][h]);
+            matchFound = true;
+        }
+        this->laneHits[k].clear();
+    }
+
+    return this->stripeLanes * stride + this->m - 1;
 }
 
 /**
-* Search for P in S
+* Search a determinate segment in a single Shift-And pass. Starting from the
+* state carried over from the previous segment, every character both extends
+* the prefixes of P matched so far and starts a new one, so the occurrences
+* crossing into a, those inside a and the prefixes of P ending at the end of a
+* all come out of the same loop.
 *
-* @param S The first segment and subsequent segments
+* Long segments are instead split in three: the prefixes carried over can only
+* be extended over the first m - 1 characters and the outgoing prefixes only
+* depend on the last m - 1, so Shift-And is run over those two ends and the
+* occurrences inside a are found with the backward scan of searchBNDM, or
+* with the striped kernel for patterns too short for BNDM.
+*
+* @param a The determinate string
+* @param pos The position of a in the text
 * @return Match Found or not
 */
-bool EDSM::searchNextSegment(const Segment & S)
+template<class BV>
+bool EDSMBV<BV>::searchDeterminateSegment(const StringView & a, const unsigned int pos)
 {
-    //start timer
-    clock_t start = clock();
+    BV D = this->B;
+    unsigned int j, c, end;
+    bool matchFound = false;
+    bool bndm = this->useBNDM && a.length >= BNDMSEGMENTFACTOR * this->m;
+    bool stripes = !bndm && this->useStripes && a.length >= STRIPEMINLENGTH;
 
-    if (this->m == 0) {
-        cerr << "Please set a pattern before searching!" << endl;
-        return false;
-    }
+    if (bndm || stripes)
+    {
+        if (D.any())
+        {
+            for (j = 0; j < this->m - 1; j++)
+            {
+                D &= this->I[this->chr2idx[(int)a.data[j]]];
+                D >>= 1;
+                if (D.test(0))
+                {
+                    this->report((int)(pos + j), (int)j);
+                    matchFound = true;
+                }
+            }
+        }
 
-    // set initial match found values
-    unsigned int j;
-    int kmpStartPos, matchIdx;
-    bool reportOnce = true;
-    bool matchFound = false;
-    bool isDeterminateSegment = false;
+        if (bndm)
+        {
+            matchFound = this->searchBNDM(a, pos) || matchFound;
+            end = a.length;
+        }
+        else
+        {
+            end = this->searchStripes(a, pos, matchFound);
+        }
 
-    // bit-vectors to temporarily hold the state of a search mid-processing
-    WORD B1, B2;
+        //the occurrences ending after end, and the outgoing prefixes
+        D.clear();
+        for (j = end - this->m + 1; j < a.length; j++)
+        {
+            c = this->chr2idx[(int)a.data[j]];
+            D &= this->I[c];
+            D >>= 1;
+            D |= this->PB[c];
+            if (D.test(0))
+            {
+                this->report((int)(pos + j), (int)j);
+                matchFound = true;
+            }
+        }
+        D.reset(0);
+        this->B = D;
+
+        return matchFound;
+    }
 
-    // define iterator for a segment. 'StringI' iterator is used to access all the strings in a segment
-    Segment::const_iterator stringI;
+    if (D.any() && a.length < this->m)
+    {
+        this->Np++;
+        this->Nm += a.length;
+    }
 
-    // Do the first segment, then search the next segments afterwards
-    if (!this->primed)
+    for (j = 0; j < a.length; j++)
     {
-        this->B = 0;
+        c = this->chr2idx[(int)a.data[j]];
+        D &= this->I[c];
+        D >>= 1;
+        D |= this->PB[c];
+        if (D.test(0))
+        {
+            this->report((int)(pos + j), (int)j);
+            matchFound = true;
+        }
+    }
+
+    //a full match is not a prefix to carry into the next segment
+    D.reset(0);
+    this->B = D;
+
+    return matchFound;
+}
+
+/**
+* Search a degenerate segment with the vector kernel run over all its strings
+* at once. Every string starts from B and the kernel returns the union of their
+* final states, which is the next B, so neither the prefix border table nor KMP
+* nor occVector are needed.
+*
+* @param S The next segment
+* @param n The number of strings in S
+* @param pos The position of S in the text
+* @return Match Found or not
+*/
+template<class BV>
+bool EDSMBV<BV>::searchAlleles(const StringView * S, const unsigned int n, const unsigned int pos)
+{
+    unsigned int s;
+    bool matchFound = false;
 
-        for (stringI = S.begin(); stringI != S.end(); ++stringI)
+    if (this->B.any())
+    {
+        for (s = 0; s < n; s++)
         {
-            //keep track of f/F counts
-            if (S.size() == 1)
+            if (S[s].length > 0 && S[s].length < this->m)
             {
-                this->f += (*stringI).length();
-                isDeterminateSegment = true;
+                this->Np++;
+                this->Nm += S[s].length;
             }
-            else if (*stringI != EPSILON)
+        }
+    }
+
+    this->B.w[0] = this->alleleKernel(this->stripeMask, this->stripeStart, this->B.w[0], S, n, this->alleleScratch, matchFound);
+    this->B.reset(0);
+    if (matchFound) {
+        this->report((int)pos, 0);
+    }
+
+    return matchFound;
+}
+
+/**
+* Find the occurrences of P inside a string of packed bases with BNDM, as
+* searchBNDM does on characters
+*
+* @param packed The packed bases
+* @param from The first base of the string
+* @param length The number of bases of the string
+* @param pos The position of the segment in the text
+* @param offset The position of the string in the segment
+* @return Match Found or not
+*/
+template<class BV>
+bool EDSMBV<BV>::searchPackedBNDM(const WORD * packed, const size_t from, const unsigned int length, const unsigned int pos, const unsigned int offset)
+{
+    const WORD top = 1ul << (this->m - 1);
+    unsigned int w = 0, j, last;
+    size_t i;
+    WORD D;
+    bool matchFound = false;
+
+    while (w + this->m <= length)
+    {
+        j = this->m;
+        last = this->m;
+        D = ~0ul;
+        while (j > 0 && D != 0)
+        {
+            //the code of A is 0 and its index in bndmMask 1
+            i = from + w + j - 1;
+            D &= this->bndmMask[((packed[i / 32] >> (2 * (i % 32))) & 3) + 1];
+            j--;
+            if (D & top)
             {
-                this->F += (*stringI).length();
-                isDeterminateSegment = false;
+                if (j > 0) {
+                    last = j;
+                } else {
+                    this->report((int)(pos + offset + w + this->m - 1), (int)(offset + w + this->m - 1));
+                    matchFound = true;
+                }
             }
+            D <<= 1;
+        }
+        w += last;
+    }
+
+    return matchFound;
+}
+
+/**
+* Report the occurrences found by the Shift-And over packed bases
+*
+* @param pos The position of the segment in the text
+* @param offset The position in the segment of the bases searched
+* @return Was any occurrence found?
+*/
+template<class BV>
+bool EDSMBV<BV>::reportPackedHits(const unsigned int pos, const unsigned int offset)
+{
+    bool matchFound = !this->packedHits.empty();
+    for (unsigned int h = 0; h < this->packedHits.size(); h++) {
+        this->report((int)(pos + offset + this->packedHits[h]), (int)(offset + this->packedHits[h]));
+    }
+    this->packedHits.clear();
+    return matchFound;
+}
+
+/**
+* Search a string of packed bases without N in it, as searchDeterminateSegment
+* does on characters: a single Shift-And pass for a short string, and for a
+* long one Shift-And over its ends and BNDM or the striped kernel inside it
+*
+* @param packed The packed bases
+* @param from The first base of the string
+* @param length The number of bases of the string
+* @param D The state before the string
+* @param pos The position of the segment in the text
+* @param offset The position of the string in the segment
+* @param matchFound Set to true if P was found
+* @return The state after the string
+*/
+template<class BV>
+WORD EDSMBV<BV>::searchPackedRun(const WORD * packed, const size_t from, const unsigned int length, WORD D, const unsigned int pos, const unsigned int offset, bool & matchFound)
+{
+    unsigned int k, h, end = 0, stride;
+    bool bndm = this->useBNDM && length >= BNDMSEGMENTFACTOR * this->m;
+    bool stripes = !bndm && length >= STRIPEMINLENGTH;
+
+    if (bndm || stripes)
+    {
+        //the prefixes carried over can only end an occurrence in the first m - 1 bases
+        if (D != 0)
+        {
+            shiftAndPacked(this->packedMask, this->stripeStart, D, packed, from, this->m - 1, this->packedHits);
+            matchFound = this->reportPackedHits(pos, offset) || matchFound;
         }
 
-        for (stringI = S.begin(); stringI != S.end(); ++stringI)
+        if (bndm)
+        {
+            matchFound = this->searchPackedBNDM(packed, from, length, pos, offset) || matchFound;
+            end = length;
+        }
+        else
         {
-            if ((*stringI).length() >= this->m)
+            stride = (length - this->m + 1) / this->stripeLanes;
+            this->packedStripeKernel(this->packedMask, this->stripeStart, packed, from, stride, stride + this->m - 1, this->laneHits);
+            for (k = 0; k < this->stripeLanes; k++)
             {
-                kmpStartPos = 0;
-                while ((matchIdx = this->KMP(this->P, *stringI, this->kmpBT, kmpStartPos)) != -1)
+                for (h = 0; h < this->laneHits[k].size(); h++)
                 {
-                    if (reportOnce && matchFound && !isDeterminateSegment) {
-                        break;
-                    }
-                    if (isDeterminateSegment) {
-                        this->report(this->pos + matchIdx, matchIdx + this->m);
-                    } else {
-                        this->report(this->pos, matchIdx + this->m);
-                    }
+                    this->report((int)(pos + offset + this->laneHits[k][h]), (int)(offset + this->laneHits[k][h]));
                     matchFound = true;
-                    kmpStartPos = 2 + matchIdx - (int)this->m;
-                    if (reportOnce && !isDeterminateSegment) {
-                        break;
-                    }
                 }
+                this->laneHits[k].clear();
             }
+            end = this->stripeLanes * stride + this->m - 1;
         }
 
-        //this->B = this->computeSegmentPrefixMatches(S);
-        this->B = this->computePrefixBorderTable(S);
-        this->primed = true;
+        //the occurrences ending after end, and the outgoing prefixes
+        end -= this->m - 1;
+        D = 0;
+    }
+
+    D = shiftAndPacked(this->packedMask, this->stripeStart, D, packed, from + end, length - end, this->packedHits);
+    matchFound = this->reportPackedHits(pos, offset + end) || matchFound;
+
+    return D;
+}
+
+/**
+* Search a determinate segment of packed bases without turning it into
+* characters. P must fit the single-word kernels, otherwise the characters are
+* searched. An N matches no base of P, so it leaves no prefix of P behind and
+* the string is searched as the runs of bases between its runs of Ns.
+*
+* @param a The segment, not empty
+* @param pos The position of a in the text
+* @return Match Found or not
+*/
+template<class BV>
+bool EDSMBV<BV>::searchPackedSegment(const PackedView & a, const unsigned int pos)
+{
+    if (!this->useStripes) {
+        return EDSMEngine::searchPackedSegment(a, pos);
     }
-    else
+
+    WORD D = this->B.w[0];
+    unsigned int j = 0, k, e;
+    bool matchFound = false;
+
+    if (D != 0 && a.length < this->m)
     {
-        //B1 = this->computeSegmentPrefixMatches(S);
-        B1 = this->computePrefixBorderTable(S);
+        this->Np++;
+        this->Nm += a.length;
+    }
 
-        for (stringI = S.begin(); stringI != S.end(); ++stringI)
+    for (k = 0; k <= a.n; k++)
+    {
+        e = (k < a.n) ? max((size_t) a.exceptions[2 * k], a.from) - a.from : a.length;
+        if (e > j) {
+            D = this->searchPackedRun(a.packed, a.from + j, e - j, D, pos, j, matchFound);
+        }
+        if (k < a.n)
         {
-            if (*stringI == EPSILON) {
-                B1 = B1 | this->B;
-                continue;
-            }
+            D = 0;
+            j = min((size_t) (a.exceptions[2 * k] + a.exceptions[2 * k + 1]), a.from + a.length) - a.from;
+        }
+    }
 
-            //keep track of f/F counts
-            if (S.size() == 1)
-            {
-                this->f += (*stringI).length();
-                isDeterminateSegment = true;
-            }
-            else
+    //a full match is not a prefix to carry into the next segment
+    this->B.w[0] = D & ~1ul;
+
+    return matchFound;
+}
+
+/**
+* Forget the state of the search, as before the first segment
+*/
+template<class BV>
+void EDSMBV<BV>::reset()
+{
+    this->B.clear();
+}
+
+/**
+* Copy the engine, sharing the border table and the suffix automaton of P
+*
+* @return A new engine in the same state
+*/
+template<class BV>
+EDSMEngine * EDSMBV<BV>::clone() const
+{
+    return new EDSMBV<BV>(*this);
+}
+
+/**
+* Search for P in the next segment S, advancing the search state B.
+*
+* Before the first segment B is empty, so the extension of previous prefixes
+* is skipped and only occurrences inside S and its prefix borders are found.
+*
+* @param S The next segment
+* @param n The number of strings in S
+* @param isDeterminateSegment Does S hold a single (determinate) string?
+* @param pos The position of S in the text
+* @return Match Found or not
+*/
+template<class BV>
+bool EDSMBV<BV>::searchNextSegment(const StringView * S, const unsigned int n, const bool isDeterminateSegment, const unsigned int pos)
+{
+    // set initial match found values
+    unsigned int j, s;
+    int matchIdx;
+    bool matchFound = false;
+
+    // bit-vectors to temporarily hold the state of a search mid-processing
+    BV B1, B2;
+
+    if (isDeterminateSegment) {
+        return this->searchDeterminateSegment(S[0], pos);
+    }
+
+    if (this->searchSNPSegment(S, n, pos, matchFound)) {
+        return matchFound;
+    }
+
+    if (this->useStripes) {
+        return this->searchAlleles(S, n, pos);
+    }
+
+    //B1 = this->computeSegmentPrefixMatches(S, n);
+    B1 = this->computePrefixBorderTable(S, n);
+
+    //a pattern is reported at most once per degenerate segment
+    for (s = 0; s < n; s++)
+    {
+        const StringView & a = S[s];
+
+        if (a.length == 0)
+        {
+            B1 |= this->B;
+            continue;
+        }
+
+        if (!matchFound && a.length >= this->m)
+        {
+            if ((matchIdx = this->KMP(this->P, a, this->kmpBT->data(), 0)) != -1)
             {
-                this->F += (*stringI).length();
-                isDeterminateSegment = false;
+                this->report(pos, matchIdx);
+                matchFound = true;
             }
         }
-
-        for (stringI = S.begin(); stringI != S.end(); ++stringI)
+        if (this->B.any())
         {
-            if (*stringI != EPSILON)
+            B2 = this->B;
+            for (j = 0; j < min(a.length, this->m - 1); j++)
             {
-                if ((*stringI).length() >= this->m)
+                B2 &= this->I[this->chr2idx[(int)a.data[j]]];
+                B2 >>= 1;
+                if (B2.test(0) && !matchFound)
                 {
-                    kmpStartPos = 0;
-                    while ((matchIdx = this->KMP(this->P, *stringI, this->kmpBT, kmpStartPos)) != -1)
-                    {
-                        if (reportOnce && matchFound && !isDeterminateSegment) {
-                            break;
-                        }
-                        if (isDeterminateSegment) {
-                            this->report(this->pos + matchIdx, matchIdx);
-                        } else {
-                            this->report(this->pos, matchIdx);
-                        }
-                        matchFound = true;
-                        kmpStartPos = 2 + matchIdx - (int)this->m;
-                        if (reportOnce && !isDeterminateSegment) {
-                            break;
-                        }
-                    }
+                    this->report((int)pos, (int)j);
+                    matchFound = true;
                 }
-                if (this->B != 0)
-                {
-                    B2 = this->B;
-                    for (j = 0; j < min((unsigned int)(*stringI).length(), this->m - 1); j++)
-                    {
-                        B2 = B2 & this->I[this->chr2idx[(int)(*stringI)[j]]];
-                        B2 = B2 >> 1;
-                        if (B2 & 1ul) {
-                            if (!(reportOnce && matchFound))
-                            {
-                                if (isDeterminateSegment) {
-                                    this->report((int)(this->pos + j), 0);
-                                } else {
-                                    this->report((int)this->pos, (int)j);
-                                }
-                                matchFound = true;
-                            }
-                        }
-                    }
+            }
 
-                    if ((*stringI).length() < this->m)
-                    {
-                        this->Np++;
-                        this->Nm += (*stringI).length();
-                        B2 = this->B & this->occVector(*stringI);
-                        B1 = B1 | (B2 >> (*stringI).length());
-                    }
-                }
+            if (a.length < this->m)
+            {
+                this->Np++;
+                this->Nm += a.length;
+                B2 = this->B & this->occVector(a);
+                B1 |= B2 >> a.length;
+            }
+        }
+    }
+
+    this->B = B1;
+
+    return matchFound;
+}
+
+template class EDSMBV< BitVector<1> >;
+template class EDSMBV< BitVector<2> >;
+template class EDSMBV< BitVector<4> >;
+template class EDSMBV< DynamicBitVector >;
+
+/**
+* Pack the patterns into as few words as possible, first fit in the order given
+*
+* @constructor
+* @param patterns Determinate patterns, each shorter than WORDSIZE
+* @param ids The indexes of the patterns
+*/
+EDSMPacked::EDSMPacked(const vector<string> & patterns, const vector<unsigned int> & ids) : EDSMEngine(ids)
+{
+    unsigned int j, k, g, m;
+    vector<unsigned int> used, offset, word;
+
+    this->mMax = 0;
+    for (k = 0; k < patterns.size(); k++)
+    {
+        m = patterns[k].length();
+        for (g = 0; g < used.size(); g++) {
+            if (used[g] + m + 1 <= WORDSIZE) {
+                break;
             }
         }
+        if (g == used.size()) {
+            used.push_back(0);
+        }
+        word.push_back(g);
+        offset.push_back(used[g]);
+        used[g] += m + 1;
+        this->mMax = max(this->mMax, m);
+    }
 
-        this->B = B1;
+    this->words = used.size();
+    this->I.assign(5 * this->words, 0ul);
+    this->start.assign(this->words, 0ul);
+    this->accept.assign(this->words, 0ul);
+    this->slot.assign(this->words * WORDSIZE, 0);
+    this->B.assign(this->words, 0ul);
+    this->B1.assign(this->words, 0ul);
+    this->B2.assign(this->words, 0ul);
+    this->hits.assign(this->words, 0ul);
+
+    for (k = 0; k < patterns.size(); k++)
+    {
+        m = patterns[k].length();
+        g = word[k];
+        for (j = 0; j < m; j++) {
+            this->I[this->chr2idx[(int)patterns[k][j]] * this->words + g] |= 1ul << (offset[k] + m - j);
+        }
+        this->start[g] |= 1ul << (offset[k] + m);
+        this->accept[g] |= 1ul << offset[k];
+        this->slot[g * WORDSIZE + offset[k]] = k;
     }
+}
 
-    //increment the segment counter and position counter
-    if (isDeterminateSegment) {
-        this->d++;
-        this->pos += S[0].length();
-    } else {
-        this->D++;
-        this->pos++;
+/**
+* Report a match for every pattern whose match bit is set in H
+*
+* @param H Packed match bits
+* @param s The position to report
+* @param i The index of the match
+*/
+void EDSMPacked::reportHits(const vector<WORD> & H, const int s, const int i)
+{
+    unsigned int g;
+    WORD h;
+    for (g = 0; g < this->words; g++)
+    {
+        for (h = H[g]; h != 0; h &= h - 1) {
+            this->report(s, i, this->slot[g * WORDSIZE + __builtin_ctzl(h)]);
+        }
     }
+}
+
+/**
+* Forget the state of the search, as before the first segment
+*/
+void EDSMPacked::reset()
+{
+    this->B.assign(this->words, 0ul);
+}
+
+/**
+* Copy the engine: its masks take a few words per pattern
+*
+* @return A new engine in the same state
+*/
+EDSMEngine * EDSMPacked::clone() const
+{
+    return new EDSMPacked(*this);
+}
+
+/**
+* Search for all the patterns of the pack in the next segment S. Every string of
+* S is run through Shift-And starting from the state B, which both extends the
+* prefixes carried over from previous segments and finds the occurrences and
+* prefix borders within the string.
+*
+* @param S The next segment
+* @param n The number of strings in S
+* @param isDeterminateSegment Does S hold a single (determinate) string?
+* @param pos The position of S in the text
+* @return Match Found or not
+*/
+bool EDSMPacked::searchNextSegment(const StringView * S, const unsigned int n, const bool isDeterminateSegment, const unsigned int pos)
+{
+    const unsigned int G = this->words;
+    const WORD * Ic;
+    unsigned int j, g;
+    WORD h;
+    bool matchFound = false;
+    unsigned int s;
+
+    if (isDeterminateSegment)
+    {
+        const StringView & a = S[0];
+        for (j = 0; j < a.length; j++)
+        {
+            Ic = &this->I[this->chr2idx[(int)a.data[j]] * G];
+            h = 0;
+            for (g = 0; g < G; g++)
+            {
+                this->B[g] = ((this->B[g] | this->start[g]) & Ic[g]) >> 1;
+                h |= this->B[g] & this->accept[g];
+            }
+            if (h != 0)
+            {
+                for (g = 0; g < G; g++) {
+                    this->hits[g] = this->B[g] & this->accept[g];
+                }
+                this->reportHits(this->hits, (int)(pos + j), (int)j);
+                matchFound = true;
+            }
+        }
+        for (g = 0; g < G; g++) {
+            this->B[g] &= ~this->start[g];
+        }
+        return matchFound;
+    }
+
+    bool active = false;
+    for (g = 0; g < G; g++)
+    {
+        this->B1[g] = 0;
+        this->hits[g] = 0;
+        active = active || this->B[g] != 0;
+    }
+
+    for (s = 0; s < n; s++)
+    {
+        if (S[s].length == 0)
+        {
+            for (g = 0; g < G; g++) {
+                this->B1[g] |= this->B[g];
+            }
+            continue;
+        }
+
+        if (active && S[s].length < this->mMax)
+        {
+            this->Np++;
+            this->Nm += S[s].length;
+        }
+
+        this->B2 = this->B;
+        for (j = 0; j < S[s].length; j++)
+        {
+            Ic = &this->I[this->chr2idx[(int)S[s].data[j]] * G];
+            for (g = 0; g < G; g++)
+            {
+                this->B2[g] = ((this->B2[g] | this->start[g]) & Ic[g]) >> 1;
+                this->hits[g] |= this->B2[g] & this->accept[g];
+            }
+        }
+        for (g = 0; g < G; g++) {
+            this->B1[g] |= this->B2[g] & ~this->start[g];
+        }
+    }
+
+    //every pattern is reported at most once per degenerate segment
+    for (g = 0; g < G; g++)
+    {
+        matchFound = matchFound || this->hits[g] != 0;
+        this->B[g] = this->B1[g];
+    }
+    if (matchFound) {
+        this->reportHits(this->hits, (int)pos, 0);
+    }
+
+    return matchFound;
+}
+
+/**
+* Build the Aho-Corasick automaton of the patterns as a complete transition table
+*
+* @constructor
+* @param patterns Determinate patterns consisting of A, C, G or T characters
+* @param ids The indexes of the patterns
+*/
+EDSMDictionary::EDSMDictionary(const vector<string> & patterns, const vector<unsigned int> & ids) : EDSMEngine(ids)
+{
+    unsigned int j, k, h;
+    int q, v, x;
+
+    AhoCorasickAutomaton * automaton = new AhoCorasickAutomaton();
+
+    //build the trie of the patterns
+    this->mMax = 0;
+    automaton->delta.assign(5, -1);
+    automaton->out.assign(1, -1);
+    automaton->sameNext.assign(patterns.size(), -1);
+    for (k = 0; k < patterns.size(); k++)
+    {
+        q = 0;
+        for (j = 0; j < patterns[k].length(); j++)
+        {
+            x = this->chr2idx[(int)patterns[k][j]];
+            if (automaton->delta[q * 5 + x] == -1)
+            {
+                automaton->delta[q * 5 + x] = automaton->out.size();
+                automaton->delta.resize(automaton->delta.size() + 5, -1);
+                automaton->out.push_back(-1);
+            }
+            q = automaton->delta[q * 5 + x];
+        }
+        automaton->sameNext[k] = automaton->out[q];
+        automaton->out[q] = k;
+        this->mMax = max(this->mMax, (unsigned int) patterns[k].length());
+    }
+
+    //complete the transitions with the failure links, breadth first
+    vector<int> fail(automaton->out.size(), 0);
+    vector<int> queue;
+    automaton->outLink.assign(automaton->out.size(), -1);
+    for (x = 0; x < 5; x++)
+    {
+        v = automaton->delta[x];
+        if (v == -1) {
+            automaton->delta[x] = 0;
+        } else {
+            queue.push_back(v);
+        }
+    }
+    for (h = 0; h < queue.size(); h++)
+    {
+        q = queue[h];
+        automaton->outLink[q] = (automaton->out[fail[q]] >= 0) ? fail[q] : automaton->outLink[fail[q]];
+        for (x = 0; x < 5; x++)
+        {
+            v = automaton->delta[q * 5 + x];
+            if (v == -1)
+            {
+                automaton->delta[q * 5 + x] = automaton->delta[fail[q] * 5 + x];
+            }
+            else
+            {
+                fail[v] = automaton->delta[fail[q] * 5 + x];
+                queue.push_back(v);
+            }
+        }
+    }
+
+    //a set never holds more than every state, so the sets are allocated once
+    this->Q.reserve(automaton->out.size());
+    this->Q1.reserve(automaton->out.size());
+    this->Q2.reserve(automaton->out.size());
+    this->Q3.reserve(automaton->out.size());
+    this->Q.assign(1, 0);
+    this->step = 0;
+    this->generation = 0;
+    this->mark.assign(automaton->out.size(), 0);
+    this->markNext.assign(automaton->out.size(), 0);
+    this->reported.assign(patterns.size(), 0);
+
+    this->automaton.reset(automaton);
+}
+
+/**
+* Advance the step stamp, clearing the stamps when the counter wraps
+*/
+void EDSMDictionary::nextStep()
+{
+    if (++this->step == 0)
+    {
+        this->mark.assign(this->mark.size(), 0);
+        this->step = 1;
+    }
+}
+
+/**
+* Advance the generation stamp, clearing the stamps when the counter wraps
+*/
+void EDSMDictionary::nextGeneration()
+{
+    if (++this->generation == 0)
+    {
+        this->markNext.assign(this->markNext.size(), 0);
+        this->reported.assign(this->reported.size(), 0);
+        this->generation = 1;
+    }
+}
+
+/**
+* Report every pattern that ends at state q
+*
+* @param q A state of the automaton
+* @param s The position to report
+* @param i The index of the match
+* @param once Only report patterns that have not been stamped with the current generation
+* @return Was anything reported?
+*/
+bool EDSMDictionary::reportState(int q, const int s, const int i, const bool once)
+{
+    bool matchFound = false;
+    int k;
+    if (this->automaton->out[q] == -1) {
+        q = this->automaton->outLink[q];
+    }
+    for (; q != -1; q = this->automaton->outLink[q])
+    {
+        for (k = this->automaton->out[q]; k != -1; k = this->automaton->sameNext[k])
+        {
+            if (once)
+            {
+                if (this->reported[k] == this->generation) {
+                    continue;
+                }
+                this->reported[k] = this->generation;
+            }
+            this->report(s, i, k);
+            matchFound = true;
+        }
+    }
+    return matchFound;
+}
+
+/**
+* Forget the state of the search, as before the first segment
+*/
+void EDSMDictionary::reset()
+{
+    this->Q.assign(1, 0);
+}
+
+/**
+* Copy the engine, sharing the automaton
+*
+* @return A new engine in the same state
+*/
+EDSMEngine * EDSMDictionary::clone() const
+{
+    EDSMDictionary * copy = new EDSMDictionary(*this);
+    unsigned int states = this->mark.size();
+    copy->Q.reserve(states);
+    copy->Q1.reserve(states);
+    copy->Q2.reserve(states);
+    copy->Q3.reserve(states);
+    return copy;
+}
+
+/**
+* Search for all the patterns of the dictionary in the next segment S
+*
+* @param S The next segment
+* @param n The number of strings in S
+* @param isDeterminateSegment Does S hold a single (determinate) string?
+* @param pos The position of S in the text
+* @return Match Found or not
+*/
+bool EDSMDictionary::searchNextSegment(const StringView * S, const unsigned int n, const bool isDeterminateSegment, const unsigned int pos)
+{
+    unsigned int j, h;
+    int q;
+    bool matchFound = false;
+    unsigned int s;
+    const AhoCorasickAutomaton & automaton = *this->automaton;
+
+    if (isDeterminateSegment)
+    {
+        const StringView & a = S[0];
+        for (j = 0; j < a.length; j++)
+        {
+            //once all paths agree on the state the automaton runs on its own
+            if (this->Q.size() == 1)
+            {
+                q = this->Q[0];
+                for (; j < a.length; j++)
+                {
+                    q = automaton.delta[q * 5 + this->chr2idx[(int)a.data[j]]];
+                    if (automaton.out[q] >= 0 || automaton.outLink[q] >= 0) {
+                        matchFound = this->reportState(q, (int)(pos + j), (int)j, false) || matchFound;
+                    }
+                }
+                this->Q[0] = q;
+                break;
+            }
+
+            //otherwise advance every state, merging those that meet
+            this->nextStep();
+            this->nextGeneration();
+            this->Q2.clear();
+            for (h = 0; h < this->Q.size(); h++)
+            {
+                q = automaton.delta[this->Q[h] * 5 + this->chr2idx[(int)a.data[j]]];
+                if (this->mark[q] != this->step)
+                {
+                    this->mark[q] = this->step;
+                    this->Q2.push_back(q);
+                    matchFound = this->reportState(q, (int)(pos + j), (int)j, true) || matchFound;
+                }
+            }
+            this->Q.swap(this->Q2);
+        }
+        return matchFound;
+    }
+
+    //every pattern is reported at most once per degenerate segment
+    this->nextGeneration();
+    this->Q1.clear();
+    for (s = 0; s < n; s++)
+    {
+        if (S[s].length == 0)
+        {
+            this->Q2 = this->Q;
+        }
+        else
+        {
+            if (S[s].length < this->mMax && (this->Q.size() > 1 || this->Q[0] != 0))
+            {
+                this->Np++;
+                this->Nm += S[s].length;
+            }
+
+            this->Q2 = this->Q;
+            for (j = 0; j < S[s].length; j++)
+            {
+                this->nextStep();
+                this->Q3.clear();
+                for (h = 0; h < this->Q2.size(); h++)
+                {
+                    q = automaton.delta[this->Q2[h] * 5 + this->chr2idx[(int)S[s].data[j]]];
+                    if (this->mark[q] != this->step)
+                    {
+                        this->mark[q] = this->step;
+                        this->Q3.push_back(q);
+                        if (automaton.out[q] >= 0 || automaton.outLink[q] >= 0) {
+                            matchFound = this->reportState(q, (int)pos, (int)j, true) || matchFound;
+                        }
+                    }
+                }
+                this->Q2.swap(this->Q3);
+            }
+        }
+
+        for (h = 0; h < this->Q2.size(); h++)
+        {
+            q = this->Q2[h];
+            if (this->markNext[q] != this->generation)
+            {
+                this->markNext[q] = this->generation;
+                this->Q1.push_back(q);
+            }
+        }
+    }
+    this->Q.swap(this->Q1);
+
+    return matchFound;
+}
+
+/**
+* Shorten the strings whose occVector is precomputed for a pattern until its
+* table gets its share of OCCTABLEBUDGET bytes, which the tables of all the
+* patterns of a CompiledPattern split between them
+*
+* @param k The length of the longest strings wanted
+* @param bytes The size of an entry of the table, heap included
+* @param tables The number of patterns with a table
+* @return The length of the longest strings of the table
+*/
+static unsigned int occTableLengthFor(unsigned int k, const size_t bytes, const unsigned int tables)
+{
+    size_t share = OCCTABLEBUDGET / max(tables, 1u);
+    while (k > 0 && ((1ul << (2 * k + 2)) - 4) / 3 * bytes > share) {
+        k--;
+    }
+    return k;
+}
+
+/**
+* Validate the patterns and build the engines that search for them
+*
+* @constructor
+* @param patterns Determinate patterns consisting of A, C, G or T characters
+* @param dictionary Match the patterns with an Aho-Corasick automaton?
+* @param occTableLength Strings up to this length get their occVector from a precomputed table,
+* shorter ones if the tables of all the patterns would not fit in OCCTABLEBUDGET
+*/
+CompiledPattern::CompiledPattern(const vector<string> & patterns, const bool dictionary, const unsigned int occTableLength)
+{
+    double start = threadTime();
+
+    unsigned int j, k;
+
+    this->duration = 0;
+
+    if (patterns.size() == 0)
+    {
+        cerr << "Error: No pattern given! Aborting!" << endl;
+        return;
+    }
+    for (k = 0; k < patterns.size(); k++)
+    {
+        const string & P = patterns[k];
+        if (P.length() == 0)
+        {
+            cerr << "Error: Pattern length 0! Aborting!" << endl;
+            return;
+        }
+        for (j = 0; j < P.length(); j++) {
+            if (!(P[j] == 'A' || P[j] == 'C' || P[j] == 'G' || P[j] == 'T')) {
+                cerr << "Error: Invalid character in pattern: '" << P[j] << "'!" << endl;
+                return;
+            }
+        }
+    }
+
+    this->patterns = patterns;
+
+    if (dictionary)
+    {
+        vector<unsigned int> ids;
+        for (k = 0; k < patterns.size(); k++) {
+            ids.push_back(k);
+        }
+        this->engines.push_back(new EDSMDictionary(patterns, ids));
+        this->duration = threadTime() - start;
+        return;
+    }
+
+    //a single pattern keeps EDSM-BV, several short ones are packed together
+    unsigned int tables = 0;
+    for (k = 0; k < patterns.size(); k++) {
+        tables += (patterns.size() == 1 || patterns[k].length() >= WORDSIZE);
+    }
+
+    vector<string> shortPatterns;
+    vector<unsigned int> shortIds;
+    for (k = 0; k < patterns.size(); k++)
+    {
+        const string & P = patterns[k];
+
+        if (patterns.size() > 1 && P.length() < WORDSIZE)
+        {
+            shortPatterns.push_back(P);
+            shortIds.push_back(k);
+            continue;
+        }
+
+        //the state of a search uses bits 0 to m, so m + 1 bits in total
+        switch (P.length() / WORDSIZE + 1) {
+            case 1:
+                this->engines.push_back(new EDSMBV< BitVector<1> >(P, k, occTableLengthFor(occTableLength, sizeof(BitVector<1>), tables)));
+                break;
+            case 2:
+                this->engines.push_back(new EDSMBV< BitVector<2> >(P, k, occTableLengthFor(occTableLength, sizeof(BitVector<2>), tables)));
+                break;
+            case 3:
+            case 4:
+                this->engines.push_back(new EDSMBV< BitVector<4> >(P, k, occTableLengthFor(occTableLength, sizeof(BitVector<4>), tables)));
+                break;
+            default:
+                this->engines.push_back(new EDSMBV< DynamicBitVector >(P, k, occTableLengthFor(occTableLength, sizeof(DynamicBitVector) + (P.length() / WORDSIZE + 1) * sizeof(WORD), tables)));
+                break;
+        }
+    }
+    if (shortPatterns.size() > 0) {
+        this->engines.push_back(new EDSMPacked(shortPatterns, shortIds));
+    }
+
+    this->duration = threadTime() - start;
+}
+
+/**
+* @destructor
+*/
+CompiledPattern::~CompiledPattern()
+{
+    for (unsigned int k = 0; k < this->engines.size(); k++) {
+        delete this->engines[k];
+    }
+}
+
+/**
+* Were the patterns valid?
+*
+* @return false if the patterns were rejected and nothing was compiled
+*/
+bool CompiledPattern::isValid() const
+{
+    return this->engines.size() > 0;
+}
+
+/**
+* Make the engines of a new search. They share the compiled tables and only
+* allocate their search state, so this is cheap and safe to call from any
+* number of threads at once.
+*
+* @return The engines in their initial state, owned by the caller
+*/
+vector<EDSMEngine *> CompiledPattern::instantiate() const
+{
+    vector<EDSMEngine *> engines;
+    for (unsigned int k = 0; k < this->engines.size(); k++) {
+        engines.push_back(this->engines[k]->clone());
+    }
+    return engines;
+}
+
+/**
+* Get the patterns compiled, in the order used to tag the matches
+*/
+const vector<string> & CompiledPattern::getPatterns() const
+{
+    return this->patterns;
+}
+
+/**
+* Get the time spent compiling the patterns
+*
+* @return The time in seconds
+*/
+double CompiledPattern::getDuration() const
+{
+    return this->duration;
+}
+
+/**
+* @constructor
+*/
+EDSM::EDSM()
+{
+    this->f = 0;
+    this->F = 0;
+    this->d = 0;
+    this->D = 0;
+    this->pos = 0;
+    this->duration = 0;
+    this->allocations = 0;
+    this->occTableLength = OCCTABLELENGTH;
+}
+
+/**
+* The constructor can be given a pattern
+*
+* @constructor
+* @param P The determinate pattern string to search the segments for
+*/
+EDSM::EDSM(const string & P) : EDSM()
+{
+    this->setPattern(P);
+}
+
+/**
+* The constructor can be given several patterns to search for in one pass
+*
+* @constructor
+* @param patterns The determinate patterns to search the segments for
+*/
+EDSM::EDSM(const vector<string> & patterns) : EDSM()
+{
+    this->setPatterns(patterns);
+}
+
+/**
+* The constructor can be given patterns compiled beforehand, e.g. to search
+* several texts for them at the same time without compiling them again
+*
+* @constructor
+* @param compiled The patterns to search the segments for
+*/
+EDSM::EDSM(const shared_ptr<const CompiledPattern> & compiled) : EDSM()
+{
+    this->setCompiledPattern(compiled);
+}
+
+/**
+* @destructor
+*/
+EDSM::~EDSM()
+{
+    for (unsigned int k = 0; k < this->engines.size(); k++) {
+        delete this->engines[k];
+    }
+}
+
+/**
+* Set the pattern to search for. Patterns of any length are accepted; the
+* engine is chosen by the number of words needed to hold m + 1 bits.
+*
+* @param P A determinate pattern consisting of A, C, G or T characters
+*/
+void EDSM::setPattern(const string & P)
+{
+    this->setPatterns(vector<string>(1, P));
+}
+
+/**
+* Set several patterns to search for at the same time. Patterns shorter than
+* WORDSIZE are packed together into a shared engine and longer ones get an
+* EDSM-BV engine each, so all of them advance on every call to searchNextSegment.
+* Matches are tagged with the index of their pattern in this list. From
+* DICTIONARYSIZE patterns on, they are matched as a dictionary instead.
+*
+* @param patterns Determinate patterns consisting of A, C, G or T characters
+*/
+void EDSM::setPatterns(const vector<string> & patterns)
+{
+    shared_ptr<const CompiledPattern> compiled = make_shared<CompiledPattern>(patterns, patterns.size() >= DICTIONARYSIZE, this->occTableLength);
+    this->duration += compiled->getDuration();
+    this->setCompiledPattern(compiled);
+}
+
+/**
+* Set a dictionary of patterns to search for with an Aho-Corasick automaton,
+* whatever the number of patterns. Matches are tagged as with setPatterns().
+*
+* @param patterns Determinate patterns consisting of A, C, G or T characters
+*/
+void EDSM::setDictionary(const vector<string> & patterns)
+{
+    shared_ptr<const CompiledPattern> compiled = make_shared<CompiledPattern>(patterns, true, this->occTableLength);
+    this->duration += compiled->getDuration();
+    this->setCompiledPattern(compiled);
+}
+
+/**
+* Search for patterns compiled beforehand, e.g. shared with other searches.
+* Patterns that were rejected when compiled are ignored.
+*
+* @param compiled The patterns to search the segments for
+*/
+void EDSM::setCompiledPattern(const shared_ptr<const CompiledPattern> & compiled)
+{
+    if (!compiled || !compiled->isValid()) {
+        return;
+    }
+
+    //reset search state
+    this->d = 0;
+    this->D = 0;
+
+    for (unsigned int k = 0; k < this->engines.size(); k++) {
+        delete this->engines[k];
+    }
+    this->engines = compiled->instantiate();
+    this->compiled = compiled;
+}
+
+/**
+* Get the compiled patterns, to start other searches for them
+*
+* @return The compiled patterns, empty if no valid pattern was set
+*/
+shared_ptr<const CompiledPattern> EDSM::getCompiledPattern() const
+{
+    return this->compiled;
+}
+
+/**
+* Set the length of the longest alleles whose occVector is looked up in a
+* table precomputed when the patterns are set. The table holds (4^(k+1) - 4) / 3
+* bit-vectors, so k = 8 takes 87380 words for a single word pattern. The
+* tables of all the patterns share OCCTABLEBUDGET bytes, so with many long
+* patterns each gets a shorter k. Takes effect from the next call to setPattern.
+*
+* @param k The length of the longest precomputed strings, 0 to disable the table, at most 12
+*/
+void EDSM::setOccTableLength(const unsigned int k)
+{
+    this->occTableLength = min(k, 12u);
+}
+
+/**
+* Get a list of the positions of matches found.
+*
+* @return A vector of ints of the position numbers where matches were found
+*/
+vector<int> EDSM::getMatches() const
+{
+    return this->matches;
+}
+
+/**
+* Get the pattern each match belongs to.
+*
+* @return A vector of pattern indexes, parallel to the one returned by getMatches()
+*/
+vector<unsigned int> EDSM::getMatchPatterns() const
+{
+    return this->matchPatterns;
+}
+
+/**
+* Get the patterns being searched for, in the order used by getMatchPatterns()
+*/
+vector<string> EDSM::getPatterns() const
+{
+    if (!this->compiled) {
+        return vector<string>();
+    }
+    return this->compiled->getPatterns();
+}
+
+/**
+* Start searching from position pos as if a had just been read: used to search
+* a part of the text on its own from the m characters before it
+*
+* @param a The determinate string before pos, at least as long as the longest pattern unless it starts the text
+* @param pos The position of the first segment after a
+*/
+void EDSM::primeWith(const StringView & a, const unsigned int pos)
+{
+    double start = threadTime();
+
+    for (unsigned int k = 0; k < this->engines.size(); k++) {
+        this->engines[k]->prime(a, pos - a.length);
+    }
+    this->pos = pos;
+
+    this->duration += threadTime() - start;
+}
+
+/**
+* Append matches found in another part of the text, e.g. by another EDSM
+*
+* @param matches The positions of the matches
+* @param matchPatterns The index of the pattern of each match
+*/
+void EDSM::addMatches(const vector<int> & matches, const vector<unsigned int> & matchPatterns)
+{
+    this->matches.insert(this->matches.end(), matches.begin(), matches.end());
+    this->matchPatterns.insert(this->matchPatterns.end(), matchPatterns.begin(), matchPatterns.end());
+}
+
+/**
+* Add the counters and processing time of another EDSM for the same patterns
+* that searched another part of the text
+*
+* @param other The other EDSM
+*/
+void EDSM::addCounters(const EDSM & other)
+{
+    this->f += other.f;
+    this->F += other.F;
+    this->d += other.d;
+    this->D += other.D;
+    this->duration += other.duration;
+    this->allocations += other.allocations;
+    for (unsigned int k = 0; k < this->engines.size() && k < other.engines.size(); k++) {
+        this->engines[k]->addCounters(*other.engines[k]);
+    }
+}
+
+/**
+* Clear the matches list
+*/
+void EDSM::clearMatches()
+{
+    this->matches.clear();
+    this->matchPatterns.clear();
+}
+
+/**
+* Get the total number of determinate segments searched so far
+*/
+unsigned int EDSM::getd() const
+{
+    return this->d;
+}
+
+/**
+* Get the total number of degenerate segments searched so far
+*/
+unsigned int EDSM::getD() const
+{
+    return this->D;
+}
+
+/**
+* Get the total length of determinate segments searched so far
+*/
+unsigned int EDSM::getf() const
+{
+    return this->f;
+}
+
+/**
+* Get the total length of degenerate segments searched so far
+*/
+unsigned int EDSM::getF() const
+{
+    return this->F;
+}
+
+/**
+* Get the total number of strings analyzed that are shorter than m
+*/
+unsigned int EDSM::getNp() const
+{
+    unsigned int Np = 0;
+    for (unsigned int k = 0; k < this->engines.size(); k++) {
+        Np += this->engines[k]->getNp();
+    }
+    return Np;
+}
+
+/**
+* Get the total length of the strings analyzed that are shorter than m
+*/
+unsigned int EDSM::getNm() const
+{
+    unsigned int Nm = 0;
+    for (unsigned int k = 0; k < this->engines.size(); k++) {
+        Nm += this->engines[k]->getNm();
+    }
+    return Nm;
+}
+
+/**
+* Get the number of heap allocations the engines made while searching, every
+* one of them as counted by the replacement operator new. It stops increasing
+* once the largest segment has been seen, showing that the search itself no
+* longer allocates memory.
+*/
+unsigned long int EDSM::getAllocations() const
+{
+    return this->allocations;
+}
+
+/**
+* Returns the execution duration of EDSM-BV in seconds
+*/
+double EDSM::getDuration() const
+{
+    return this->duration;
+}
+
+/**
+* Search for the patterns in S
+*
+* @param S The first segment and subsequent segments
+* @return Match Found or not
+*/
+bool EDSM::searchNextSegment(const Segment & S)
+{
+    this->views.resize(S.size());
+    for (unsigned int s = 0; s < S.size(); s++)
+    {
+        this->views[s].data = S[s].data();
+        this->views[s].length = (S[s] == EPSILON) ? 0 : S[s].length();
+    }
+    return this->searchNextSegment(this->views.data(), S.size());
+}
+
+/**
+* Search for the patterns in a segment stored as one flat buffer, e.g. straight
+* from the input file, without building a Segment
+*
+* @param data The concatenated strings of the segment
+* @param offsets The n + 1 offsets of the strings in data: string s is data[offsets[s]..offsets[s + 1])
+* @param n The number of strings in the segment, an empty string being epsilon
+* @return Match Found or not
+*/
+bool EDSM::searchNextSegment(const char * data, const unsigned int * offsets, const unsigned int n)
+{
+    this->views.resize(n);
+    for (unsigned int s = 0; s < n; s++)
+    {
+        this->views[s].data = data + offsets[s];
+        this->views[s].length = offsets[s + 1] - offsets[s];
+    }
+    return this->searchNextSegment(this->views.data(), n);
+}
+
+/**
+* Collect the matches reported by an engine
+*
+* @param k The index of the engine
+*/
+void EDSM::collectMatches(const unsigned int k)
+{
+    vector<int> & found = this->engines[k]->getMatches();
+    vector<unsigned int> & foundPatterns = this->engines[k]->getMatchPatterns();
+    this->matches.insert(this->matches.end(), found.begin(), found.end());
+    this->matchPatterns.insert(this->matchPatterns.end(), foundPatterns.begin(), foundPatterns.end());
+    found.clear();
+    foundPatterns.clear();
+}
+
+/**
+* Search for the patterns in S
+*
+* @param S The strings of the segment, an empty string being epsilon
+* @param n The number of strings in S
+* @return Match Found or not
+*/
+bool EDSM::searchNextSegment(const StringView * S, const unsigned int n)
+{
+    //start timer
+    double start = threadTime();
+
+    if (this->engines.size() == 0) {
+        cerr << "Please set a pattern before searching!" << endl;
+        return false;
+    }
+
+    bool isDeterminateSegment = (n == 1 && S[0].length > 0);
+    bool matchFound = false;
+
+    //keep track of f/F counts
+    for (unsigned int s = 0; s < n; s++)
+    {
+        if (isDeterminateSegment) {
+            this->f += S[s].length;
+        } else {
+            this->F += S[s].length;
+        }
+    }
+
+    for (unsigned int k = 0; k < this->engines.size(); k++)
+    {
+        unsigned long int before = getHeapAllocations();
+        bool found = this->engines[k]->searchNextSegment(S, n, isDeterminateSegment, this->pos);
+        this->allocations += getHeapAllocations() - before;
+        if (found)
+        {
+            this->collectMatches(k);
+            matchFound = true;
+        }
+    }
+
+    //increment the segment counter and position counter
+    if (isDeterminateSegment) {
+        this->d++;
+        this->pos += S[0].length;
+    } else {
+        this->D++;
+        this->pos++;
+    }
+
+    this->duration += threadTime() - start;
+
+    return matchFound;
+}
+
+/**
+* Search a determinate segment of 2-bit packed bases, e.g. straight out of a
+* binary EDS file. Engines with kernels for packed bases never turn it into
+* characters.
+*
+* @param a The segment, not empty
+* @return Match Found or not
+*/
+bool EDSM::searchPackedSegment(const PackedView & a)
+{
+    //start timer
+    double start = threadTime();
+
+    if (this->engines.size() == 0) {
+        cerr << "Please set a pattern before searching!" << endl;
+        return false;
+    }
+
+    bool matchFound = false;
+    this->f += a.length;
+
+    for (unsigned int k = 0; k < this->engines.size(); k++)
+    {
+        unsigned long int before = getHeapAllocations();
+        bool found = this->engines[k]->searchPackedSegment(a, this->pos);
+        this->allocations += getHeapAllocations() - before;
+        if (found)
+        {
+            this->collectMatches(k);
+            matchFound = true;
+        }
+    }
+
+    this->d++;
+    this->pos += a.length;
 
-    this->duration += clock() - start;
+    this->duration += threadTime() - start;
 
     return matchFound;
 }
@@ -21,68 +21,97 @@
 #include <cstdlib>
 #include <string>
 #include <vector>
-#include <sdsl/util.hpp>
-#include <sdsl/suffix_trees.hpp>
-
-typedef sdsl::cst_sct3<> cst_t;
-typedef sdsl::cst_sada<> cst_d;
-typedef cst_t::node_type node_t;
-typedef cst_t::size_type size_type;
-typedef cst_t::char_type char_t;
+#include <memory>
+#include "bitvector.hpp"
+#include "patternindex.hpp"
+#include "kernels.hpp"
+
 typedef std::vector<std::string> Segment;
 typedef std::vector<Segment> GenIndSeq;
-#define WORD unsigned long int
-#define WORDSIZE (sizeof(WORD) * 8)
 #define EPSILON "E"
 #define BUFFERSIZE 1000000
-
-class EDSM
+#define DICTIONARYSIZE 1000
+#define OCCTABLELENGTH 8
+#define OCCTABLEBUDGET (1ul << 26)
+#define BNDMMINLENGTH 16
+#define BNDMSEGMENTFACTOR 4
+
+/**
+ * A string of a segment given as a pointer into memory owned by the caller,
+ * so segments can be searched without copying them into std::strings. The
+ * empty string stands for epsilon.
+ */
+struct StringView
 {
-private:
-
-    WORD recAssignOVMem(const node_t & u);
-
-protected:
+    const char * data;
+    unsigned int length;
+};
 
+/**
+ * A determinate string of 2-bit packed bases held by the caller, e.g. in a
+ * mapped binary EDS file: A = 0, C = 1, G = 2 and T = 3, base i in bits
+ * 2 * (i % 32) of packed[i / 32]. The N bases of the string are packed as A
+ * and listed in exceptions as runs, which may start before the string or end
+ * after it.
+ */
+struct PackedView
+{
     /**
-     * @var matches All matches found as tuples of segment number and ending-position
+     * @var packed The packed bases
      */
-    std::vector<int> matches;
+    const WORD * packed;
 
     /**
-     * @var OVMem Stores bitvectors representing positions of nodes in STp
+     * @var from The index of the first base of the string in packed
      */
-    std::vector<WORD> OVMem;
+    size_t from;
 
     /**
-     * @var P The determinate pattern to find in T
+     * @var length The number of bases of the string
      */
-    std::string P;
+    unsigned int length;
 
     /**
-     * @var m The length of P
+     * @var exceptions The runs of N bases that overlap the string, in increasing
+     * order, each as the index in packed of its first base and its number of bases
      */
-    unsigned int m;
+    const WORD * exceptions;
 
     /**
-     * @var f The total length of determinate segments searched
+     * @var n The number of runs in exceptions
      */
-    unsigned int f;
+    unsigned int n;
+};
+
+void unpackView(const PackedView & a, char * out);
+
+const WORD * findRun(const WORD * runs, const size_t n, const uint64_t base);
+
+/**
+ * An engine holds one or more compiled patterns and the state of their search.
+ * The part shared by all engines is the bookkeeping of matches, each of which
+ * is tagged with the index of the pattern it belongs to. The large compiled
+ * tables are never written after construction and are shared by the clones of
+ * an engine, so a clone only allocates its own search state.
+ */
+class EDSMEngine
+{
+protected:
 
     /**
-     * @var F the total length of degenerate segments searched
+     * @var matches Matches found since they were last collected
      */
-    unsigned int F;
+    std::vector<int> matches;
 
     /**
-     * @var d The number of determinate segments searched so far
+     * @var matchPatterns The index of the pattern of each match in matches
      */
-    unsigned int d;
+    std::vector<unsigned int> matchPatterns;
 
     /**
-     * @var D The number of degenerate segments searched so far
+     * @var ids The indexes of the patterns held by the engine, as given to EDSM
      */
-    unsigned int D;
+    std::vector<unsigned int> ids;
 
     /**
      * @var Np The total number of strings analyzed with length < m
@@ -95,41 +124,91 @@ protected:
     unsigned int Nm;
 
     /**
-     * @var pos The current position in the input file being read. Degenerate
-     * positions/segments count as 1 position, whereas determinate segments are
-     * counted as N positions (as many characters as there are in the segment).
+     * @var chr2idx A lookup array used in combination with I to convert characters to indexes of I
      */
-    unsigned int pos;
+    int chr2idx[117] = {0};
 
     /**
-     * @var duration The amount of time spent by EDSM-BV
+     * @var scratchText The concatenation buffer, kept across segments
      */
-    double duration;
+    std::string scratchText;
+
+    /**
+     * @var scratchBT The border table buffer, kept across segments
+     */
+    std::vector<int> scratchBT;
 
     /**
-     * @var STp The suffix tree (array) of P
+     * @var unpacked The characters of a packed string the engine cannot search packed
      */
-    cst_t STp;
+    std::string unpacked;
+
+    void reserveScratch(const unsigned int n);
+
+    void report(const int s, const int i, const unsigned int k = 0);
+
+public:
+
+    EDSMEngine(const std::vector<unsigned int> & ids);
+
+    virtual ~EDSMEngine();
+
+    virtual bool searchNextSegment(const StringView * S, const unsigned int n, const bool isDeterminateSegment, const unsigned int pos) = 0;
+
+    virtual bool searchPackedSegment(const PackedView & a, const unsigned int pos);
+
+    virtual void reset() = 0;
+
+    virtual EDSMEngine * clone() const = 0;
+
+    void prime(const StringView & a, const unsigned int pos);
+
+    void addCounters(const EDSMEngine & other);
+
+    std::vector<int> & getMatches();
+
+    std::vector<unsigned int> & getMatchPatterns();
+
+    unsigned int getNp() const;
+
+    unsigned int getNm() const;
+
+};
+
+/**
+ * EDSM-BV for a pattern whose search state fits in a bit-vector of type BV.
+ * Instantiated for BitVector<1>, BitVector<2>, BitVector<4> and the
+ * DynamicBitVector fallback.
+ */
+template<class BV>
+class EDSMBV : public EDSMEngine
+{
+protected:
 
     /**
-     * @var kmpBT The border table for P used in the KMP search
+     * @var P The determinate pattern to find in T
      */
-    int * kmpBT;
+    std::string P;
 
     /**
-     * @var chr2idx A lookup array used in combination with I to convert characters to indexes of I
+     * @var m The length of P
      */
-    int chr2idx[117] = {0};
+    unsigned int m;
+
+    /**
+     * @var kmpBT The border table for P used in the KMP search, shared by the clones
+     */
+    std::shared_ptr< const std::vector<int> > kmpBT;
 
     /**
-     * @var primed Has the algorithm been primed with an initial segment to search?
+     * @var SAp The suffix automaton of P, storing the occVector encoding of every substring of P, shared by the clones
      */
-    bool primed;
+    std::shared_ptr< const PatternIndex<BV> > SAp;
 
     /**
      * @var B Bitvector maintaining the current state of the search
      */
-    WORD B;
+    BV B;
 
     /**
      * @var I A bitvector representing the positions of the letters in P
@@ -143,21 +222,400 @@ protected:
      *
      * Note that index 'A' is actually 1 to 'T' 4. Also, the bits are shifted one position further to the left.
      */
-    WORD I[5] = {0};
+    BV I[5];
+
+    /**
+     * @var PB The prefix bit of every character: bit m - 1 in PB[c] when P starts with c
+     */
+    BV PB[5];
 
-    WORD computeSegmentPrefixMatches(const Segment & S);
+    /**
+     * @var useBNDM Are the interiors of long determinate segments scanned backwards?
+     */
+    bool useBNDM;
 
-    WORD computePrefixBorderTable(const Segment & S);
+    /**
+     * @var bndmMask The masks of the reversed P used by BNDM: bit m - 1 - j in bndmMask[c] when P[j] = c
+     */
+    WORD bndmMask[5];
+
+    /**
+     * @var useStripes Is P short enough for the single-word vector kernels, i.e. the striped kernel and alleleKernel?
+     */
+    bool useStripes;
+
+    /**
+     * @var stripeMask The masks of I indexed directly by character, for the striped kernel
+     */
+    WORD stripeMask[256];
+
+    /**
+     * @var stripeStart The bit of the empty prefix, bit m
+     */
+    WORD stripeStart;
+
+    /**
+     * @var stripeKernel The striped Shift-And kernel for the processor
+     */
+    StripeKernel stripeKernel;
+
+    /**
+     * @var stripeLanes The number of stripes searched by stripeKernel at once
+     */
+    unsigned int stripeLanes;
+
+    /**
+     * @var laneHits The occurrences found by every lane of the striped kernel
+     */
+    std::vector<unsigned int> laneHits[MAXLANES];
+
+    /**
+     * @var alleleKernel The kernel searching all the strings of a degenerate segment at once
+     */
+    AlleleKernel alleleKernel;
+
+    /**
+     * @var alleleScratch The strings of a degenerate segment interleaved by alleleKernel
+     */
+    std::vector<unsigned char> alleleScratch;
+
+    /**
+     * @var packedMask The masks of I indexed by 2-bit code, for the packed kernels
+     */
+    WORD packedMask[4];
+
+    /**
+     * @var packedStripeKernel The striped Shift-And kernel over packed bases for the processor
+     */
+    PackedStripeKernel packedStripeKernel;
+
+    /**
+     * @var packedHits The occurrences found by the Shift-And over packed bases
+     */
+    std::vector<unsigned int> packedHits;
 
     void constructKMPBT();
 
-    int KMP(const std::string & needle, const std::string & haystack, int * B, int i);
+    int KMP(const std::string & needle, const StringView & haystack, const int * B, int i);
+
+    BV computeSegmentPrefixMatches(const StringView * S, const unsigned int n);
+
+    BV computePrefixBorderTable(const StringView * S, const unsigned int n);
+
+    BV occVector(const StringView & a);
+
+    bool searchSNPSegment(const StringView * S, const unsigned int n, const unsigned int pos, bool & matchFound);
+
+    bool searchBNDM(const StringView & a, const unsigned int pos);
+
+    unsigned int searchStripes(const StringView & a, const unsigned int pos, bool & matchFound);
+
+    bool searchDeterminateSegment(const StringView & a, const unsigned int pos);
+
+    bool searchAlleles(const StringView * S, const unsigned int n, const unsigned int pos);
 
-    void report(const int s, const int i);
+    bool reportPackedHits(const unsigned int pos, const unsigned int offset);
 
-    WORD occVector(const std::string & a);
+    bool searchPackedBNDM(const WORD * packed, const size_t from, const unsigned int length, const unsigned int pos, const unsigned int offset);
 
-    void constructOV();
+    WORD searchPackedRun(const WORD * packed, const size_t from, const unsigned int length, WORD D, const unsigned int pos, const unsigned int offset, bool & matchFound);
+
+public:
+
+    EDSMBV(const std::string & P, const unsigned int id = 0, const unsigned int occTableLength = OCCTABLELENGTH);
+
+    bool searchNextSegment(const StringView * S, const unsigned int n, const bool isDeterminateSegment, const unsigned int pos);
+
+    bool searchPackedSegment(const PackedView & a, const unsigned int pos);
+
+    void reset();
+
+    EDSMEngine * clone() const;
+
+};
+
+/**
+ * Shift-And over several short patterns packed side by side into machine words.
+ * Pattern k occupies the m_k + 1 bits starting at its offset o_k: bit o_k is its
+ * match bit and bit o_k + m_k stands for the empty prefix, which is injected
+ * before every character. The words are advanced together on every character,
+ * so one pass over a segment searches all the patterns of the pack.
+ */
+class EDSMPacked : public EDSMEngine
+{
+protected:
+
+    /**
+     * @var words The number of words the patterns are packed into
+     */
+    unsigned int words;
+
+    /**
+     * @var mMax The length of the longest pattern in the pack
+     */
+    unsigned int mMax;
+
+    /**
+     * @var I The packed I bit-vectors, I[c * words + g] is word g of the mask of character c
+     */
+    std::vector<WORD> I;
+
+    /**
+     * @var start The empty prefix bit of every pattern
+     */
+    std::vector<WORD> start;
+
+    /**
+     * @var accept The match bit of every pattern
+     */
+    std::vector<WORD> accept;
+
+    /**
+     * @var slot slot[g * WORDSIZE + b] is the pattern whose match bit is bit b of word g
+     */
+    std::vector<unsigned int> slot;
+
+    /**
+     * @var B The packed state of the search: B1, B2 and hits are scratch space of the same size
+     */
+    std::vector<WORD> B, B1, B2, hits;
+
+    void reportHits(const std::vector<WORD> & H, const int s, const int i);
+
+public:
+
+    EDSMPacked(const std::vector<std::string> & patterns, const std::vector<unsigned int> & ids);
+
+    bool searchNextSegment(const StringView * S, const unsigned int n, const bool isDeterminateSegment, const unsigned int pos);
+
+    void reset();
+
+    EDSMEngine * clone() const;
+
+};
+
+/**
+ * The Aho-Corasick automaton of a dictionary of patterns, shared by the clones
+ * of an EDSMDictionary
+ */
+struct AhoCorasickAutomaton
+{
+    /**
+     * @var delta The complete transition function of the automaton: delta[q * 5 + chr2idx[c]]
+     */
+    std::vector<int> delta;
+
+    /**
+     * @var out The first pattern ending at each state, or -1
+     */
+    std::vector<int> out;
+
+    /**
+     * @var outLink The nearest state on the failure chain with an output, or -1
+     */
+    std::vector<int> outLink;
+
+    /**
+     * @var sameNext The next pattern that is identical to a given pattern, or -1
+     */
+    std::vector<int> sameNext;
+};
+
+/**
+ * Dictionary matching of many patterns with an Aho-Corasick automaton. Where
+ * EDSM-BV carries a bit-vector of the prefixes of P that end the text read so
+ * far, this engine carries the set of automaton states reached by the different
+ * strings spelled by the degenerate segments. The set is kept as a sparse set
+ * and collapses back to a single state on determinate segments, so the cost
+ * per character does not depend on the number of patterns.
+ */
+class EDSMDictionary : public EDSMEngine
+{
+protected:
+
+    /**
+     * @var automaton The automaton of the patterns
+     */
+    std::shared_ptr<const AhoCorasickAutomaton> automaton;
+
+    /**
+     * @var mMax The length of the longest pattern
+     */
+    unsigned int mMax;
+
+    /**
+     * @var Q The current set of states, one for every distinct state reached
+     */
+    std::vector<int> Q;
+
+    /**
+     * @var Q1 The set of states being built for the next segment, Q2 and Q3 are scratch space
+     */
+    std::vector<int> Q1, Q2, Q3;
+
+    /**
+     * @var mark Step stamps making Q2 and Q3 sparse sets over the states
+     */
+    std::vector<unsigned int> mark;
+
+    /**
+     * @var markNext Generation stamps making Q1 a sparse set over the states
+     */
+    std::vector<unsigned int> markNext;
+
+    /**
+     * @var reported Generation stamps of the patterns already reported at the current position or segment
+     */
+    std::vector<unsigned int> reported;
+
+    /**
+     * @var step The current stamp of mark, advanced on every character read by several states
+     */
+    unsigned int step;
+
+    /**
+     * @var generation The current stamp of markNext and reported, advanced on every position or degenerate segment
+     */
+    unsigned int generation;
+
+    void nextStep();
+
+    void nextGeneration();
+
+    bool reportState(int q, const int s, const int i, const bool once);
+
+public:
+
+    EDSMDictionary(const std::vector<std::string> & patterns, const std::vector<unsigned int> & ids);
+
+    bool searchNextSegment(const StringView * S, const unsigned int n, const bool isDeterminateSegment, const unsigned int pos);
+
+    void reset();
+
+    EDSMEngine * clone() const;
+
+};
+
+/**
+ * Patterns compiled once into engines that are never searched themselves.
+ * The object is immutable once constructed, so any number of EDSM searches,
+ * on any number of threads, can be started from one shared_ptr to it and
+ * only allocate their own search state.
+ */
+class CompiledPattern
+{
+protected:
+
+    /**
+     * @var engines The engines compiled for the patterns, in their initial state.
+     * Short patterns are packed into a shared engine; the others get an EDSM-BV
+     * engine chosen by the number of words they need.
+     */
+    std::vector<EDSMEngine *> engines;
+
+    /**
+     * @var patterns The patterns compiled
+     */
+    std::vector<std::string> patterns;
+
+    /**
+     * @var duration The amount of time spent compiling the patterns
+     */
+    double duration;
+
+public:
+
+    CompiledPattern(const std::vector<std::string> & patterns, const bool dictionary, const unsigned int occTableLength = OCCTABLELENGTH);
+
+    ~CompiledPattern();
+
+    bool isValid() const;
+
+    std::vector<EDSMEngine *> instantiate() const;
+
+    const std::vector<std::string> & getPatterns() const;
+
+    double getDuration() const;
+
+};
+
+/**
+ * The search of an elastic-degenerate text for the patterns of a
+ * CompiledPattern: the engines in their current state, the matches and the
+ * counters of one stream of segments
+ */
+class EDSM
+{
+protected:
+
+    /**
+     * @var compiled The patterns being searched for
+     */
+    std::shared_ptr<const CompiledPattern> compiled;
+
+    /**
+     * @var engines The search state of the engines of compiled
+     */
+    std::vector<EDSMEngine *> engines;
+
+    /**
+     * @var matches All matches found as tuples of segment number and ending-position
+     */
+    std::vector<int> matches;
+
+    /**
+     * @var matchPatterns The index of the pattern each entry of matches belongs to
+     */
+    std::vector<unsigned int> matchPatterns;
+
+    /**
+     * @var f The total length of determinate segments searched
+     */
+    unsigned int f;
+
+    /**
+     * @var F the total length of degenerate segments searched
+     */
+    unsigned int F;
+
+    /**
+     * @var d The number of determinate segments searched so far
+     */
+    unsigned int d;
+
+    /**
+     * @var D The number of degenerate segments searched so far
+     */
+    unsigned int D;
+
+    /**
+     * @var pos The current position in the input file being read. Degenerate
+     * positions/segments count as 1 position, whereas determinate segments are
+     * counted as N positions (as many characters as there are in the segment).
+     */
+    unsigned int pos;
+
+    /**
+     * @var duration The amount of time spent by EDSM-BV
+     */
+    double duration;
+
+    /**
+     * @var allocations The number of allocations made by the engines while searching
+     */
+    unsigned long int allocations;
+
+    /**
+     * @var occTableLength Strings up to this length get their occVector from a precomputed table
+     */
+    unsigned int occTableLength;
+
+    /**
+     * @var views The views of the segment being searched, kept across segments
+     */
+    std::vector<StringView> views;
+
+    void collectMatches(const unsigned int k);
 
 public:
 
@@ -165,14 +623,44 @@ public:
 
     EDSM(const std::string & P);
 
+    EDSM(const std::vector<std::string> & patterns);
+
+    EDSM(const std::shared_ptr<const CompiledPattern> & compiled);
+
     ~EDSM();
 
+    void setCompiledPattern(const std::shared_ptr<const CompiledPattern> & compiled);
+
+    std::shared_ptr<const CompiledPattern> getCompiledPattern() const;
+
     void setPattern(const std::string & P);
 
+    void setPatterns(const std::vector<std::string> & patterns);
+
+    void setDictionary(const std::vector<std::string> & patterns);
+
+    void setOccTableLength(const unsigned int k);
+
     bool searchNextSegment(const Segment & S);
 
+    bool searchNextSegment(const StringView * S, const unsigned int n);
+
+    bool searchNextSegment(const char * data, const unsigned int * offsets, const unsigned int n);
+
+    bool searchPackedSegment(const PackedView & a);
+
+    void primeWith(const StringView & a, const unsigned int pos);
+
+    void addMatches(const std::vector<int> & matches, const std::vector<unsigned int> & matchPatterns);
+
+    void addCounters(const EDSM & other);
+
     std::vector<int> getMatches() const;
 
+    std::vector<unsigned int> getMatchPatterns() const;
+
+    std::vector<std::string> getPatterns() const;
+
     void clearMatches();
 
     double getDuration() const;
@@ -189,6 +677,8 @@ public:
 
     unsigned int getNm() const;
 
+    unsigned long int getAllocations() const;
+
 };
 
 #endif
@@ -0,0 +1,398 @@
+/*
+    EDSM: Elastic Degenerate String Matching
+
+    Copyright (C) 2017 Chang Liu, Solon P. Pissis, Ahmad Retha and Fatima Vayani.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include "fmindex.hpp"
+
+using namespace std;
+
+/**
+* The wall clock time
+*
+* @return The time in seconds
+*/
+static double wallTime()
+{
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+* Search the next segment of a binary EDS file, packed if it is determinate
+*
+* @param eds The file
+* @param edsm The search
+* @param views Scratch space for the strings of the segment
+* @param need Only the first need bases of a determinate segment are searched
+* @param length Set to the length of the shortest string of the segment
+* @return Was there a segment left?
+*/
+static bool searchNextSegment(BinaryEDS & eds, EDSM & edsm, vector<StringView> & views, const uint64_t need, uint64_t & length)
+{
+    PackedView run;
+    if (eds.nextPackedSegment(run))
+    {
+        length = run.length;
+        if (run.length > need)
+        {
+            run.length = need;
+            while (run.n > 0 && run.exceptions[2 * (run.n - 1)] >= run.from + need) {
+                run.n--;
+            }
+        }
+        edsm.searchPackedSegment(run);
+        return true;
+    }
+    if (!eds.nextSegment(views)) {
+        return false;
+    }
+    length = views[0].length;
+    for (unsigned int s = 1; s < views.size(); s++) {
+        length = min(length, (uint64_t) views[s].length);
+    }
+    edsm.searchNextSegment(views.data(), views.size());
+    return true;
+}
+
+/**
+* @constructor
+*/
+FMIndex::FMIndex()
+{
+    this->segments = 0;
+    this->strings = 0;
+    this->bases = 0;
+    this->verified = 0;
+    this->duration = 0;
+}
+
+/**
+* Index the strings of a binary EDS file
+*
+* @param eds The file, from which no segment has been read yet
+* @return Was the whole file read?
+*/
+bool FMIndex::build(BinaryEDS & eds)
+{
+    this->segments = eds.getSegments();
+    this->strings = eds.getStrings();
+    this->bases = eds.getBases();
+
+    //every string is followed by '#', so no occurrence of a pattern spans two strings
+    string text;
+    text.reserve(this->bases + this->strings);
+    this->stringStarts = sdsl::bit_vector(this->bases + this->strings + 1, 0);
+    this->segmentStarts = sdsl::bit_vector(this->strings + 1, 0);
+    this->positions = sdsl::int_vector<>(this->segments + 1, 0, 64);
+    this->determinate = sdsl::bit_vector(this->segments, 0);
+
+    vector<StringView> views;
+    uint64_t pos = 0, s = 0, j = 0;
+    while (eds.nextSegment(views))
+    {
+        if (views.size() == 0 || s + views.size() > this->strings) {
+            return false;
+        }
+        bool isDeterminateSegment = (views.size() == 1 && views[0].length > 0);
+        this->segmentStarts[s] = 1;
+        this->positions[j] = pos;
+        this->determinate[j] = isDeterminateSegment;
+        for (const auto & a : views)
+        {
+            this->stringStarts[text.length()] = 1;
+            text.append(a.data, a.length);
+            text += '#';
+            s++;
+        }
+        pos += isDeterminateSegment ? views[0].length : 1;
+        j++;
+    }
+    if (!eds.isComplete()) {
+        return false;
+    }
+    this->stringStarts[text.length()] = 1;
+    this->segmentStarts[s] = 1;
+    this->positions[j] = pos;
+    sdsl::util::bit_compress(this->positions);
+
+    sdsl::util::init_support(this->stringRank, &this->stringStarts);
+    sdsl::util::init_support(this->stringSelect, &this->stringStarts);
+    sdsl::util::init_support(this->segmentRank, &this->segmentStarts);
+    sdsl::util::init_support(this->segmentSelect, &this->segmentStarts);
+    sdsl::construct_im(this->csa, text, 1);
+
+    return true;
+}
+
+/**
+* Write the index to a file
+*
+* @param name The path of the file
+* @return Was the file written?
+*/
+bool FMIndex::save(const string & name) const
+{
+    ofstream out(name.c_str(), ios::out | ios::binary | ios::trunc);
+    if (!out.good()) {
+        return false;
+    }
+    out.write(FMINDEXMAGIC, 8);
+    sdsl::write_member(this->segments, out);
+    sdsl::write_member(this->strings, out);
+    sdsl::write_member(this->bases, out);
+    this->csa.serialize(out);
+    this->stringStarts.serialize(out);
+    this->stringRank.serialize(out);
+    this->stringSelect.serialize(out);
+    this->segmentStarts.serialize(out);
+    this->segmentRank.serialize(out);
+    this->segmentSelect.serialize(out);
+    this->positions.serialize(out);
+    this->determinate.serialize(out);
+    out.close();
+
+    return !out.fail();
+}
+
+/**
+* Read an index written by save
+*
+* @param name The path of the file
+* @return Was the file read?
+*/
+bool FMIndex::load(const string & name)
+{
+    ifstream in(name.c_str(), ios::in | ios::binary);
+    char magic[8];
+    if (!in.read(magic, 8) || memcmp(magic, FMINDEXMAGIC, 8) != 0) {
+        return false;
+    }
+    sdsl::read_member(this->segments, in);
+    sdsl::read_member(this->strings, in);
+    sdsl::read_member(this->bases, in);
+    this->csa.load(in);
+    this->stringStarts.load(in);
+    this->stringRank.load(in, &this->stringStarts);
+    this->stringSelect.load(in, &this->stringStarts);
+    this->segmentStarts.load(in);
+    this->segmentRank.load(in, &this->segmentStarts);
+    this->segmentSelect.load(in, &this->segmentStarts);
+    this->positions.load(in);
+    this->determinate.load(in);
+
+    return in.good() && this->stringStarts.size() == this->bases + this->strings + 1 && this->segmentStarts.size() == this->strings + 1 && this->positions.size() == this->segments + 1 && this->determinate.size() == this->segments;
+}
+
+/**
+* Was the index built from a binary EDS file?
+*
+* @param eds The file
+* @return Do the file and the index have the same numbers of segments, strings and bases?
+*/
+bool FMIndex::isIndexOf(const BinaryEDS & eds) const
+{
+    return eds.getSegments() == this->segments && eds.getStrings() == this->strings && eds.getBases() == this->bases;
+}
+
+/**
+* Find the segment of a position of the indexed text
+*
+* @param t The position
+* @param offset Set to the offset of t in its string
+* @return The index of the segment
+*/
+uint64_t FMIndex::segmentOf(const uint64_t t, uint64_t & offset) const
+{
+    uint64_t s = this->stringRank(t + 1) - 1;
+    offset = t - this->stringSelect(s + 1);
+    return this->segmentRank(s + 1) - 1;
+}
+
+/**
+* Get the index of the first base of a segment in the binary EDS file: the
+* strings before it are each followed by a '#' in the indexed text
+*
+* @param segment The index of the segment, or the number of segments for the end
+* @return The index of the base
+*/
+uint64_t FMIndex::firstBase(const uint64_t segment) const
+{
+    uint64_t s = this->segmentSelect(segment + 1);
+    return this->stringSelect(s + 1) - s;
+}
+
+/**
+* Find all the matches of the patterns of an EDSM. Occurrences inside a string
+* come straight from the index. A match crossing segments starts in a string
+* ending with a proper prefix of its pattern: every segment holding such a
+* string is searched by the EDSM, from its last bases if it is determinate,
+* together with the segments after it until the longest pattern would have
+* ended, the last of them only as far as that. The matches replace those of the EDSM, in order of position and
+* pattern.
+*
+* @param eds The binary EDS file the index was built from
+* @param edsm The search, whose patterns are used
+* @return false if the file is not that of the index or there are no patterns
+*/
+bool FMIndex::search(BinaryEDS & eds, EDSM & edsm)
+{
+    double start = wallTime();
+
+    this->verified = 0;
+
+    vector<string> patterns = edsm.getPatterns();
+    if (patterns.size() == 0 || !this->isIndexOf(eds)) {
+        return false;
+    }
+
+    //the longest pattern decides how far a crossing match may reach
+    unsigned int pLen = 0;
+    for (const auto & P : patterns) {
+        pLen = max(pLen, (unsigned int) P.length());
+    }
+
+    vector< pair<int, unsigned int> > found;
+    vector<uint64_t> candidates;
+    uint64_t lb, rb, i, j, offset;
+    for (unsigned int k = 0; k < patterns.size(); k++)
+    {
+        const string & P = patterns[k];
+
+        //occurrences inside a string
+        if (sdsl::backward_search(this->csa, 0, this->csa.size() - 1, P.begin(), P.end(), lb, rb) > 0)
+        {
+            for (i = lb; i <= rb; i++)
+            {
+                j = this->segmentOf(this->csa[i], offset);
+                if (this->determinate[j]) {
+                    found.push_back(make_pair((int) (this->positions[j] + offset + P.length() - 1), k));
+                } else {
+                    found.push_back(make_pair((int) this->positions[j], k));
+                }
+            }
+        }
+
+        //strings ending with P[0..l), after which a match may go on
+        for (unsigned int l = 1; l < P.length(); l++)
+        {
+            string q = P.substr(0, l) + '#';
+            if (sdsl::backward_search(this->csa, 0, this->csa.size() - 1, q.begin(), q.end(), lb, rb) > 0)
+            {
+                for (i = lb; i <= rb; i++) {
+                    candidates.push_back(this->segmentOf(this->csa[i], offset));
+                }
+            }
+        }
+    }
+    sort(candidates.begin(), candidates.end());
+    candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
+
+    //the search goes on from where it stopped when the next candidate is the
+    //segment it has just read, and starts again otherwise
+    edsm.clearMatches();
+    vector<StringView> views;
+    string tail;
+    uint64_t next = this->segments, need, length, from, to;
+    for (const auto c : candidates)
+    {
+        if (c + 1 >= this->segments) {
+            continue;
+        }
+        if (next != c + 1)
+        {
+            if (this->determinate[c])
+            {
+                to = this->firstBase(c + 1);
+                from = max(this->firstBase(c), to - min(to, (uint64_t) pLen - 1));
+                eds.getBases(from, to, tail);
+                StringView a;
+                a.data = tail.data();
+                a.length = tail.length();
+                edsm.primeWith(a, this->positions[c + 1]);
+                eds.seek(c + 1, to);
+            }
+            else
+            {
+                StringView a;
+                a.data = NULL;
+                a.length = 0;
+                edsm.primeWith(a, this->positions[c]);
+                eds.seek(c, this->firstBase(c));
+                searchNextSegment(eds, edsm, views, UINT64_MAX, length);
+                this->verified++;
+            }
+            next = c + 1;
+        }
+        for (need = pLen - 1; need > 0 && next < this->segments; next++)
+        {
+            if (!searchNextSegment(eds, edsm, views, need, length)) {
+                break;
+            }
+            this->verified++;
+            if (length >= need)
+            {
+                //the longest pattern has ended on every path, and only the start of
+                //a long determinate segment was searched, so the search stops here
+                next = this->segments;
+                break;
+            }
+            need -= length;
+        }
+    }
+
+    vector<int> matches = edsm.getMatches();
+    vector<unsigned int> matchPatterns = edsm.getMatchPatterns();
+    for (i = 0; i < matches.size(); i++) {
+        found.push_back(make_pair(matches[i], matchPatterns[i]));
+    }
+    sort(found.begin(), found.end());
+    found.erase(unique(found.begin(), found.end()), found.end());
+
+    matches.clear();
+    matchPatterns.clear();
+    for (const auto & a : found)
+    {
+        matches.push_back(a.first);
+        matchPatterns.push_back(a.second);
+    }
+    edsm.clearMatches();
+    edsm.addMatches(matches, matchPatterns);
+
+    this->duration = wallTime() - start;
+
+    return true;
+}
+
+/**
+* Get the number of segments searched by the last search for matches crossing segments
+*/
+unsigned long int FMIndex::getVerified() const
+{
+    return this->verified;
+}
+
+/**
+* Get the time spent by the last search, in seconds
+*/
+double FMIndex::getDuration() const
+{
+    return this->duration;
+}
@@ -0,0 +1,140 @@
+/*
+    EDSM: Elastic Degenerate String Matching
+
+    Copyright (C) 2017 Chang Liu, Solon P. Pissis, Ahmad Retha and Fatima Vayani.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __FMINDEX__
+#define __FMINDEX__
+
+#include <cstdlib>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <sdsl/suffix_arrays.hpp>
+#include <sdsl/bit_vectors.hpp>
+#include "edsm.hpp"
+#include "binaryeds.hpp"
+
+#define FMINDEXMAGIC "EDSMFMI1"
+
+/**
+ * An FM-index over the strings of a binary EDS file, for answering many
+ * queries on the same text without scanning it. The indexed text holds every
+ * string, determinate segments and alleles alike, each followed by '#', so an
+ * occurrence inside a string is found by backward search alone. The segment
+ * boundaries are kept as bit-vectors over the text and the strings, and a
+ * match that crosses segments is checked by EDSM on the few segments after a
+ * string ending with a prefix of the pattern, read from the binary EDS file.
+ */
+class FMIndex
+{
+protected:
+
+    /**
+     * @var csa The compressed suffix array of the strings
+     */
+    sdsl::csa_wt<sdsl::wt_huff<>, 32, 64> csa;
+
+    /**
+     * @var stringStarts A 1 where every string starts in the indexed text, and after its end
+     */
+    sdsl::bit_vector stringStarts;
+
+    /**
+     * @var stringRank The string of a position of the indexed text
+     */
+    sdsl::rank_support_v5<1> stringRank;
+
+    /**
+     * @var stringSelect The position of a string in the indexed text
+     */
+    sdsl::select_support_mcl<1> stringSelect;
+
+    /**
+     * @var segmentStarts A 1 at the first string of every segment, and after the last string
+     */
+    sdsl::bit_vector segmentStarts;
+
+    /**
+     * @var segmentRank The segment of a string
+     */
+    sdsl::rank_support_v5<1> segmentRank;
+
+    /**
+     * @var segmentSelect The first string of a segment
+     */
+    sdsl::select_support_mcl<1> segmentSelect;
+
+    /**
+     * @var positions The position EDSM reports for every segment: the first
+     * base of a determinate segment or the degenerate segment itself
+     */
+    sdsl::int_vector<> positions;
+
+    /**
+     * @var determinate A 1 for every determinate segment
+     */
+    sdsl::bit_vector determinate;
+
+    /**
+     * @var segments The number of segments indexed
+     */
+    uint64_t segments;
+
+    /**
+     * @var strings The number of strings indexed
+     */
+    uint64_t strings;
+
+    /**
+     * @var bases The number of bases indexed
+     */
+    uint64_t bases;
+
+    /**
+     * @var verified The number of segments checked for crossing matches by the last search
+     */
+    unsigned long int verified;
+
+    /**
+     * @var duration The time spent by the last search
+     */
+    double duration;
+
+    uint64_t segmentOf(const uint64_t t, uint64_t & offset) const;
+
+    uint64_t firstBase(const uint64_t segment) const;
+
+public:
+
+    FMIndex();
+
+    bool build(BinaryEDS & eds);
+
+    bool save(const std::string & name) const;
+
+    bool load(const std::string & name);
+
+    bool isIndexOf(const BinaryEDS & eds) const;
+
+    bool search(BinaryEDS & eds, EDSM & edsm);
+
+    unsigned long int getVerified() const;
+
+    double getDuration() const;
+
+};
+
+#endif
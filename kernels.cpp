@@ -0,0 +1,795 @@
+/*
+    EDSM: Elastic Degenerate String Matching
+
+    Copyright (C) 2017 Chang Liu, Solon P. Pissis, Ahmad Retha and Fatima Vayani.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <immintrin.h>
+#include "edsm.hpp"
+#include "kernels.hpp"
+
+using namespace std;
+
+/**
+* Striped Shift-And in plain C++ over 4 lanes. The lanes are independent, so
+* even without SIMD the processor overlaps their dependency chains.
+*/
+void shiftAndStripesScalar(const WORD * mask, const WORD start, const char * a, const unsigned int stride, const unsigned int steps, vector<unsigned int> * hits)
+{
+    const unsigned char * u = (const unsigned char *) a;
+    WORD D0 = 0, D1 = 0, D2 = 0, D3 = 0;
+    unsigned int t;
+
+    for (t = 0; t < steps; t++)
+    {
+        D0 = ((D0 | start) & mask[u[t]]) >> 1;
+        D1 = ((D1 | start) & mask[u[stride + t]]) >> 1;
+        D2 = ((D2 | start) & mask[u[2 * stride + t]]) >> 1;
+        D3 = ((D3 | start) & mask[u[3 * stride + t]]) >> 1;
+        if ((D0 | D1 | D2 | D3) & 1ul)
+        {
+            if (D0 & 1ul) {
+                hits[0].push_back(t);
+            }
+            if (D1 & 1ul) {
+                hits[1].push_back(stride + t);
+            }
+            if (D2 & 1ul) {
+                hits[2].push_back(2 * stride + t);
+            }
+            if (D3 & 1ul) {
+                hits[3].push_back(3 * stride + t);
+            }
+        }
+    }
+}
+
+/**
+* The characters A, C, T, G and N have distinct bits 1 to 3, so (c >> 1) & 7
+* indexes an 8-entry table held in registers, which the vector kernels use in
+* place of memory lookups. This only works on strings of those characters.
+*
+* @param mask The transition table indexed by character
+* @param table Set to the 8 entries, table[(c >> 1) & 7] = mask[c]
+*/
+static void registerTable(const WORD * mask, WORD * table)
+{
+    unsigned int k;
+    for (k = 0; k < 8; k++) {
+        table[k] = 0;
+    }
+    table[('A' >> 1) & 7] = mask[(int)'A'];
+    table[('C' >> 1) & 7] = mask[(int)'C'];
+    table[('G' >> 1) & 7] = mask[(int)'G'];
+    table[('T' >> 1) & 7] = mask[(int)'T'];
+    table[('N' >> 1) & 7] = mask[(int)'N'];
+}
+
+/**
+* Striped Shift-And over the 4 64-bit lanes of an AVX2 register. Every lane
+* loads 8 characters at once and the masks are looked up in registers, the
+* low and high halves of the 64-bit masks being permuted separately.
+*/
+__attribute__((target("avx2")))
+void shiftAndStripesAVX2(const WORD * mask, const WORD start, const char * a, const unsigned int stride, const unsigned int steps, vector<unsigned int> * hits)
+{
+    const unsigned char * u = (const unsigned char *) a;
+    WORD table[8];
+    unsigned int t, s, k;
+    int h;
+
+    registerTable(mask, table);
+    const __m256i TL = _mm256_setr_epi32(table[0], table[1], table[2], table[3], table[4], table[5], table[6], table[7]);
+    const __m256i TH = _mm256_setr_epi32(table[0] >> 32, table[1] >> 32, table[2] >> 32, table[3] >> 32,
+                                         table[4] >> 32, table[5] >> 32, table[6] >> 32, table[7] >> 32);
+    const __m256i S = _mm256_set1_epi64x(start);
+    const __m256i offsets = _mm256_setr_epi64x(0, stride, 2 * stride, 3 * stride);
+    __m256i D = _mm256_setzero_si256(), V, idx, M;
+
+    for (t = 0; t < steps; t += 8)
+    {
+        if (t + 8 <= steps) {
+            V = _mm256_i64gather_epi64((const long long int *) (u + t), offsets, 1);
+        } else {
+            V = _mm256_setzero_si256();
+            for (s = 0; t + s < steps; s++) {
+                V = _mm256_or_si256(V, _mm256_slli_epi64(_mm256_setr_epi64x(u[t + s], u[stride + t + s], u[2 * stride + t + s], u[3 * stride + t + s]), 8 * s));
+            }
+        }
+        for (s = 0; s < 8 && t + s < steps; s++)
+        {
+            idx = _mm256_shuffle_epi32(_mm256_srli_epi64(V, 1), _MM_SHUFFLE(2, 2, 0, 0));
+            M = _mm256_blend_epi32(_mm256_permutevar8x32_epi32(TL, idx), _mm256_permutevar8x32_epi32(TH, idx), 0xAA);
+            D = _mm256_srli_epi64(_mm256_and_si256(_mm256_or_si256(D, S), M), 1);
+            V = _mm256_srli_epi64(V, 8);
+            h = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_slli_epi64(D, 63)));
+            if (h != 0)
+            {
+                for (k = 0; k < 4; k++) {
+                    if (h & (1 << k)) {
+                        hits[k].push_back(k * stride + t + s);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+* Striped Shift-And over the 8 64-bit lanes of an AVX-512 register. Every lane
+* loads 8 characters at once and a single permute looks their masks up.
+*/
+__attribute__((target("avx512f")))
+void shiftAndStripesAVX512(const WORD * mask, const WORD start, const char * a, const unsigned int stride, const unsigned int steps, vector<unsigned int> * hits)
+{
+    const unsigned char * u = (const unsigned char *) a;
+    WORD table[8];
+    unsigned int t, s, k;
+    __mmask8 h;
+
+    registerTable(mask, table);
+    const __m512i T = _mm512_loadu_si512((const void *) table);
+    const __m512i S = _mm512_set1_epi64(start);
+    const __m512i one = _mm512_set1_epi64(1);
+    const __m512i offsets = _mm512_setr_epi64(0, stride, 2 * stride, 3 * stride, 4 * stride, 5 * stride, 6 * stride, 7 * stride);
+    __m512i D = _mm512_setzero_si512(), V;
+
+    for (t = 0; t < steps; t += 8)
+    {
+        if (t + 8 <= steps) {
+            V = _mm512_mask_i64gather_epi64(_mm512_setzero_si512(), 0xFF, offsets, (const void *) (u + t), 1);
+        } else {
+            V = _mm512_setzero_si512();
+            for (s = 0; t + s < steps; s++) {
+                V = _mm512_or_si512(V, _mm512_maskz_slli_epi64(0xFF, _mm512_setr_epi64(u[t + s], u[stride + t + s], u[2 * stride + t + s], u[3 * stride + t + s],
+                    u[4 * stride + t + s], u[5 * stride + t + s], u[6 * stride + t + s], u[7 * stride + t + s]), 8 * s));
+            }
+        }
+        for (s = 0; s < 8 && t + s < steps; s++)
+        {
+            D = _mm512_maskz_srli_epi64(0xFF, _mm512_and_si512(_mm512_or_si512(D, S), _mm512_maskz_permutexvar_epi64(0xFF, _mm512_maskz_srli_epi64(0xFF, V, 1), T)), 1);
+            V = _mm512_maskz_srli_epi64(0xFF, V, 8);
+            h = _mm512_test_epi64_mask(D, one);
+            if (h != 0)
+            {
+                for (k = 0; k < 8; k++) {
+                    if (h & (1 << k)) {
+                        hits[k].push_back(k * stride + t + s);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+* Get count 2-bit packed bases starting at base b as the low bits of a word,
+* only reading the words that hold them
+*
+* @param packed The packed bases
+* @param b The first base
+* @param count The number of bases, at most 32
+* @return The bases, the first in bits 0 and 1
+*/
+static inline WORD packedWindow(const WORD * packed, const size_t b, const unsigned int count)
+{
+    const unsigned int shift = 2 * (b % 32);
+    WORD w = packed[b / 32] >> shift;
+    if (shift > 0 && b % 32 + count > 32) {
+        w |= packed[b / 32 + 1] << (64 - shift);
+    }
+    return w;
+}
+
+/**
+* Fill a table of 8 masks from the 4 indexed by 2-bit code, the upper half
+* repeating the lower, so the 3-bit indexes of the vector permutes need no
+* masking
+*
+* @param mask The transition table indexed by 2-bit code
+* @param table Set to the 8 entries, table[k] = mask[k % 4]
+*/
+static void packedRegisterTable(const WORD * mask, WORD * table)
+{
+    for (unsigned int k = 0; k < 8; k++) {
+        table[k] = mask[k % 4];
+    }
+}
+
+/**
+* Striped Shift-And over 2-bit packed bases in plain C++ over 4 lanes
+*/
+void shiftAndPackedStripesScalar(const WORD * mask, const WORD start, const WORD * packed, const size_t from, const unsigned int stride, const unsigned int steps, vector<unsigned int> * hits)
+{
+    WORD D0 = 0, D1 = 0, D2 = 0, D3 = 0, V0, V1, V2, V3;
+    unsigned int t, s, count;
+
+    for (t = 0; t < steps; t += 32)
+    {
+        count = min(32u, steps - t);
+        V0 = packedWindow(packed, from + t, count);
+        V1 = packedWindow(packed, from + stride + t, count);
+        V2 = packedWindow(packed, from + 2 * stride + t, count);
+        V3 = packedWindow(packed, from + 3 * stride + t, count);
+        for (s = 0; s < count; s++)
+        {
+            D0 = ((D0 | start) & mask[V0 & 3]) >> 1;
+            D1 = ((D1 | start) & mask[V1 & 3]) >> 1;
+            D2 = ((D2 | start) & mask[V2 & 3]) >> 1;
+            D3 = ((D3 | start) & mask[V3 & 3]) >> 1;
+            V0 >>= 2;
+            V1 >>= 2;
+            V2 >>= 2;
+            V3 >>= 2;
+            if ((D0 | D1 | D2 | D3) & 1ul)
+            {
+                if (D0 & 1ul) {
+                    hits[0].push_back(t + s);
+                }
+                if (D1 & 1ul) {
+                    hits[1].push_back(stride + t + s);
+                }
+                if (D2 & 1ul) {
+                    hits[2].push_back(2 * stride + t + s);
+                }
+                if (D3 & 1ul) {
+                    hits[3].push_back(3 * stride + t + s);
+                }
+            }
+        }
+    }
+}
+
+/**
+* Striped Shift-And over 2-bit packed bases on the 4 64-bit lanes of an AVX2
+* register. Every lane holds 32 bases and the low 3 bits of the lane are the
+* index of the permutes, as in shiftAndStripesAVX2.
+*/
+__attribute__((target("avx2")))
+void shiftAndPackedStripesAVX2(const WORD * mask, const WORD start, const WORD * packed, const size_t from, const unsigned int stride, const unsigned int steps, vector<unsigned int> * hits)
+{
+    WORD table[8];
+    unsigned int t, s, k, count;
+    int h;
+
+    packedRegisterTable(mask, table);
+    const __m256i TL = _mm256_setr_epi32(table[0], table[1], table[2], table[3], table[4], table[5], table[6], table[7]);
+    const __m256i TH = _mm256_setr_epi32(table[0] >> 32, table[1] >> 32, table[2] >> 32, table[3] >> 32,
+                                         table[4] >> 32, table[5] >> 32, table[6] >> 32, table[7] >> 32);
+    const __m256i S = _mm256_set1_epi64x(start);
+    __m256i D = _mm256_setzero_si256(), V, idx, M;
+
+    for (t = 0; t < steps; t += 32)
+    {
+        count = min(32u, steps - t);
+        V = _mm256_setr_epi64x(packedWindow(packed, from + t, count), packedWindow(packed, from + stride + t, count),
+                               packedWindow(packed, from + 2 * stride + t, count), packedWindow(packed, from + 3 * stride + t, count));
+        for (s = 0; s < count; s++)
+        {
+            idx = _mm256_shuffle_epi32(V, _MM_SHUFFLE(2, 2, 0, 0));
+            M = _mm256_blend_epi32(_mm256_permutevar8x32_epi32(TL, idx), _mm256_permutevar8x32_epi32(TH, idx), 0xAA);
+            D = _mm256_srli_epi64(_mm256_and_si256(_mm256_or_si256(D, S), M), 1);
+            V = _mm256_srli_epi64(V, 2);
+            h = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_slli_epi64(D, 63)));
+            if (h != 0)
+            {
+                for (k = 0; k < 4; k++) {
+                    if (h & (1 << k)) {
+                        hits[k].push_back(k * stride + t + s);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+* Striped Shift-And over 2-bit packed bases on the 8 64-bit lanes of an
+* AVX-512 register, a single permute looking the masks up
+*/
+__attribute__((target("avx512f")))
+void shiftAndPackedStripesAVX512(const WORD * mask, const WORD start, const WORD * packed, const size_t from, const unsigned int stride, const unsigned int steps, vector<unsigned int> * hits)
+{
+    WORD table[8], window[8];
+    unsigned int t, s, k, count;
+    __mmask8 h;
+
+    packedRegisterTable(mask, table);
+    const __m512i T = _mm512_loadu_si512((const void *) table);
+    const __m512i S = _mm512_set1_epi64(start);
+    const __m512i one = _mm512_set1_epi64(1);
+    __m512i D = _mm512_setzero_si512(), V;
+
+    for (t = 0; t < steps; t += 32)
+    {
+        count = min(32u, steps - t);
+        for (k = 0; k < 8; k++) {
+            window[k] = packedWindow(packed, from + k * stride + t, count);
+        }
+        V = _mm512_loadu_si512((const void *) window);
+        for (s = 0; s < count; s++)
+        {
+            D = _mm512_maskz_srli_epi64(0xFF, _mm512_and_si512(_mm512_or_si512(D, S), _mm512_maskz_permutexvar_epi64(0xFF, V, T)), 1);
+            V = _mm512_maskz_srli_epi64(0xFF, V, 2);
+            h = _mm512_test_epi64_mask(D, one);
+            if (h != 0)
+            {
+                for (k = 0; k < 8; k++) {
+                    if (h & (1 << k)) {
+                        hits[k].push_back(k * stride + t + s);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+* Shift-And over a string of 2-bit packed bases, loading 32 bases at a time
+* and looking their masks up by code
+*
+* @param mask The transition table indexed by 2-bit code
+* @param start The bit of the empty prefix, bit m, injected before every base
+* @param D The state before the string
+* @param packed The packed bases
+* @param from The first base of the string
+* @param length The number of bases of the string
+* @param hits The end positions, from from, of the occurrences found
+* @return The state after the string
+*/
+WORD shiftAndPacked(const WORD * mask, const WORD start, WORD D, const WORD * packed, const size_t from, const unsigned int length, vector<unsigned int> & hits)
+{
+    unsigned int t, s, count;
+    WORD V;
+
+    for (t = 0; t < length; t += count)
+    {
+        count = min(32 - (unsigned int) ((from + t) % 32), length - t);
+        V = packed[(from + t) / 32] >> (2 * ((from + t) % 32));
+        for (s = 0; s < count; s++)
+        {
+            D = ((D | start) & mask[V & 3]) >> 1;
+            V >>= 2;
+            if (D & 1ul) {
+                hits.push_back(t + s);
+            }
+        }
+    }
+
+    return D;
+}
+
+/**
+* The characters of the 256 bytes of 4 packed bases
+*/
+struct QuadTable
+{
+    char quad[256][4];
+
+    QuadTable()
+    {
+        const char * bases = "ACGT";
+        for (unsigned int c = 0; c < 256; c++) {
+            for (unsigned int j = 0; j < 4; j++) {
+                this->quad[c][j] = bases[(c >> (2 * j)) & 3];
+            }
+        }
+    }
+};
+
+/**
+* Turn 2-bit packed bases into the characters A, C, G and T, a byte of four
+* bases at a time
+*
+* @param packed The packed bases
+* @param from The first base
+* @param length The number of bases
+* @param out Where the characters are written
+*/
+void unpackBases(const WORD * packed, const size_t from, const size_t length, char * out)
+{
+    static const QuadTable table;
+    const unsigned char * bytes = (const unsigned char *) packed;
+    size_t i = from, to = from + length;
+
+    for (; i < to && i % 4 != 0; i++) {
+        *out++ = table.quad[bytes[i / 4]][i % 4];
+    }
+    for (; i + 4 <= to; i += 4, out += 4) {
+        memcpy(out, table.quad[bytes[i / 4]], 4);
+    }
+    for (; i < to; i++) {
+        *out++ = table.quad[bytes[i / 4]][i % 4];
+    }
+}
+
+/**
+* Shift-And over the strings of a degenerate segment one after the other
+*/
+WORD shiftAndAllelesScalar(const WORD * mask, const WORD start, const WORD B, const StringView * S, const unsigned int n, vector<unsigned char> & scratch, bool & matchFound)
+{
+    WORD D, out = 0, found = 0;
+    unsigned int s, j;
+
+    for (s = 0; s < n; s++)
+    {
+        const unsigned char * u = (const unsigned char *) S[s].data;
+        D = B;
+        for (j = 0; j < S[s].length; j++)
+        {
+            D = ((D | start) & mask[u[j]]) >> 1;
+            found |= D;
+        }
+        out |= D;
+    }
+    matchFound = matchFound || (found & 1ul);
+
+    return out;
+}
+
+/**
+* Copy up to lanes strings of S into scratch so that character t of every
+* string sits at scratch[t * lanes + k], one row per step of the kernel
+*
+* @return The length of the longest of the strings
+*/
+static unsigned int interleave(const StringView * S, const unsigned int n, const unsigned int lanes, vector<unsigned char> & scratch)
+{
+    unsigned int k, t, maxLen = 0;
+
+    for (k = 0; k < n; k++) {
+        maxLen = max(maxLen, S[k].length);
+    }
+    if (scratch.size() < maxLen * lanes) {
+        scratch.resize(max((size_t) maxLen * lanes, 2 * scratch.size()));
+    }
+    for (k = 0; k < n; k++) {
+        for (t = 0; t < S[k].length; t++) {
+            scratch[t * lanes + k] = S[k].data[t];
+        }
+    }
+
+    return maxLen;
+}
+
+/**
+* Shift-And over the strings of a degenerate segment, 4 at a time in the lanes
+* of an AVX2 register
+*/
+__attribute__((target("avx2")))
+WORD shiftAndAllelesAVX2(const WORD * mask, const WORD start, const WORD B, const StringView * S, const unsigned int n, vector<unsigned char> & scratch, bool & matchFound)
+{
+    WORD table[8], w[4];
+    unsigned int g, k, t, maxLen;
+    int c4, found = 0;
+
+    registerTable(mask, table);
+    const __m256i TL = _mm256_setr_epi32(table[0], table[1], table[2], table[3], table[4], table[5], table[6], table[7]);
+    const __m256i TH = _mm256_setr_epi32(table[0] >> 32, table[1] >> 32, table[2] >> 32, table[3] >> 32,
+                                         table[4] >> 32, table[5] >> 32, table[6] >> 32, table[7] >> 32);
+    const __m256i St = _mm256_set1_epi64x(start);
+    __m256i out = _mm256_setzero_si256(), D, C, M, idx, len, active;
+
+    for (g = 0; g < n; g += 4)
+    {
+        k = min(4u, n - g);
+        maxLen = interleave(S + g, k, 4, scratch);
+        len = _mm256_setr_epi64x(S[g].length, k > 1 ? S[g + 1].length : 0, k > 2 ? S[g + 2].length : 0, k > 3 ? S[g + 3].length : 0);
+        D = _mm256_set1_epi64x(B);
+        for (t = 0; t < maxLen; t++)
+        {
+            memcpy(&c4, &scratch[t * 4], 4);
+            C = _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(c4));
+            idx = _mm256_shuffle_epi32(_mm256_srli_epi64(C, 1), _MM_SHUFFLE(2, 2, 0, 0));
+            M = _mm256_blend_epi32(_mm256_permutevar8x32_epi32(TL, idx), _mm256_permutevar8x32_epi32(TH, idx), 0xAA);
+            active = _mm256_cmpgt_epi64(len, _mm256_set1_epi64x(t));
+            D = _mm256_blendv_epi8(D, _mm256_srli_epi64(_mm256_and_si256(_mm256_or_si256(D, St), M), 1), active);
+            found |= _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_and_si256(_mm256_slli_epi64(D, 63), active)));
+        }
+        //lanes without a string must not add B to the result
+        if (k < 4)
+        {
+            _mm256_storeu_si256((__m256i *) w, D);
+            for (; k < 4; k++) {
+                w[k] = 0;
+            }
+            D = _mm256_loadu_si256((const __m256i *) w);
+        }
+        out = _mm256_or_si256(out, D);
+    }
+    matchFound = matchFound || found != 0;
+
+    _mm256_storeu_si256((__m256i *) w, out);
+    return w[0] | w[1] | w[2] | w[3];
+}
+
+/**
+* Shift-And over the strings of a degenerate segment, 8 at a time in the lanes
+* of an AVX-512 register
+*/
+__attribute__((target("avx512f")))
+WORD shiftAndAllelesAVX512(const WORD * mask, const WORD start, const WORD B, const StringView * S, const unsigned int n, vector<unsigned char> & scratch, bool & matchFound)
+{
+    WORD table[8], lengths[8], w[8];
+    unsigned int g, k, t, maxLen;
+    __mmask8 active, valid, found = 0;
+
+    registerTable(mask, table);
+    const __m512i T = _mm512_loadu_si512((const void *) table);
+    const __m512i St = _mm512_set1_epi64(start);
+    const __m512i one = _mm512_set1_epi64(1);
+    __m512i out = _mm512_setzero_si512(), D, C, M, len;
+
+    for (g = 0; g < n; g += 8)
+    {
+        k = min(8u, n - g);
+        maxLen = interleave(S + g, k, 8, scratch);
+        for (t = 0; t < 8; t++) {
+            lengths[t] = t < k ? S[g + t].length : 0;
+        }
+        len = _mm512_loadu_si512((const void *) lengths);
+        valid = (__mmask8) ((1u << k) - 1);
+        D = _mm512_set1_epi64(B);
+        for (t = 0; t < maxLen; t++)
+        {
+            C = _mm512_maskz_cvtepu8_epi64(0xFF, _mm_loadl_epi64((const __m128i *) &scratch[t * 8]));
+            M = _mm512_maskz_permutexvar_epi64(0xFF, _mm512_maskz_srli_epi64(0xFF, C, 1), T);
+            active = _mm512_cmpgt_epu64_mask(len, _mm512_set1_epi64(t));
+            D = _mm512_mask_srli_epi64(D, active, _mm512_and_si512(_mm512_or_si512(D, St), M), 1);
+            found |= _mm512_mask_test_epi64_mask(active, D, one);
+        }
+        out = _mm512_mask_or_epi64(out, valid, out, D);
+    }
+    matchFound = matchFound || found != 0;
+
+    _mm512_storeu_si512((void *) w, out);
+    return w[0] | w[1] | w[2] | w[3] | w[4] | w[5] | w[6] | w[7];
+}
+
+/**
+* Classify the characters of the EDS text one at a time
+*/
+void classifyScalar(const char * t, const size_t blocks, CharClasses * classes)
+{
+    size_t b;
+    unsigned int j;
+    WORD bit;
+    char c, f;
+
+    for (b = 0; b < blocks; b++)
+    {
+        classes[b].base = classes[b].lower = classes[b].delim = classes[b].skip = 0;
+        for (j = 0; j < 64; j++)
+        {
+            c = t[b * 64 + j];
+            f = c | 0x20;
+            bit = 1ul << j;
+            if (f == 'a' || f == 'c' || f == 'g' || f == 't' || f == 'n')
+            {
+                classes[b].base |= bit;
+                if (c == f) {
+                    classes[b].lower |= bit;
+                }
+            }
+            else if (c == '{' || c == ',' || c == '}')
+            {
+                classes[b].delim |= bit;
+            }
+            else if (f == 'e' || c == '\n' || c == '\r' || c == ' ' || c == '\t')
+            {
+                classes[b].skip |= bit;
+            }
+        }
+    }
+}
+
+/**
+* Classify the characters of the EDS text 32 at a time with AVX2 compares.
+* Setting bit 5 folds letters to lower case, so each base needs one compare.
+*/
+__attribute__((target("avx2")))
+void classifyAVX2(const char * t, const size_t blocks, CharClasses * classes)
+{
+    const __m256i caseBit = _mm256_set1_epi8(0x20);
+    __m256i v, f, base, lower, delim, skip;
+    WORD m[4];
+    size_t b;
+    unsigned int h;
+
+    for (b = 0; b < blocks; b++)
+    {
+        for (h = 0; h < 2; h++)
+        {
+            v = _mm256_loadu_si256((const __m256i *) (t + b * 64 + h * 32));
+            f = _mm256_or_si256(v, caseBit);
+            base = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(f, _mm256_set1_epi8('a')), _mm256_cmpeq_epi8(f, _mm256_set1_epi8('c'))),
+                   _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(f, _mm256_set1_epi8('g')), _mm256_cmpeq_epi8(f, _mm256_set1_epi8('t'))),
+                                   _mm256_cmpeq_epi8(f, _mm256_set1_epi8('n'))));
+            lower = _mm256_and_si256(base, _mm256_cmpeq_epi8(f, v));
+            delim = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(','))),
+                                    _mm256_cmpeq_epi8(v, _mm256_set1_epi8('}')));
+            skip = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(f, _mm256_set1_epi8('e')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'))),
+                   _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '))),
+                                   _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))));
+            m[0] = (unsigned int) _mm256_movemask_epi8(base);
+            m[1] = (unsigned int) _mm256_movemask_epi8(lower);
+            m[2] = (unsigned int) _mm256_movemask_epi8(delim);
+            m[3] = (unsigned int) _mm256_movemask_epi8(skip);
+            if (h == 0)
+            {
+                classes[b].base = m[0];
+                classes[b].lower = m[1];
+                classes[b].delim = m[2];
+                classes[b].skip = m[3];
+            }
+            else
+            {
+                classes[b].base |= m[0] << 32;
+                classes[b].lower |= m[1] << 32;
+                classes[b].delim |= m[2] << 32;
+                classes[b].skip |= m[3] << 32;
+            }
+        }
+    }
+}
+
+/**
+* Classify the characters of the EDS text 64 at a time with AVX-512BW mask
+* compares, which give the bit masks directly
+*/
+__attribute__((target("avx512f,avx512bw")))
+void classifyAVX512(const char * t, const size_t blocks, CharClasses * classes)
+{
+    const __m512i caseBit = _mm512_set1_epi8(0x20);
+    __m512i v, f;
+    __mmask64 base;
+    size_t b;
+
+    for (b = 0; b < blocks; b++)
+    {
+        v = _mm512_loadu_si512((const void *) (t + b * 64));
+        f = _mm512_or_si512(v, caseBit);
+        base = _mm512_cmpeq_epi8_mask(f, _mm512_set1_epi8('a')) | _mm512_cmpeq_epi8_mask(f, _mm512_set1_epi8('c'))
+             | _mm512_cmpeq_epi8_mask(f, _mm512_set1_epi8('g')) | _mm512_cmpeq_epi8_mask(f, _mm512_set1_epi8('t'))
+             | _mm512_cmpeq_epi8_mask(f, _mm512_set1_epi8('n'));
+        classes[b].base = base;
+        classes[b].lower = base & _mm512_cmpeq_epi8_mask(f, v);
+        classes[b].delim = _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('{')) | _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8(','))
+                         | _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('}'));
+        classes[b].skip = _mm512_cmpeq_epi8_mask(f, _mm512_set1_epi8('e')) | _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('\n'))
+                        | _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('\r')) | _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8(' '))
+                        | _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('\t'));
+    }
+}
+
+/**
+* @var kernelSets The kernel sets from the most portable to the fastest
+*/
+static const KernelSet kernelSets[] = {
+    {"scalar", shiftAndStripesScalar, 4, shiftAndAllelesScalar, classifyScalar, shiftAndPackedStripesScalar},
+    {"avx2", shiftAndStripesAVX2, 4, shiftAndAllelesAVX2, classifyAVX2, shiftAndPackedStripesAVX2},
+    {"avx512", shiftAndStripesAVX512, 8, shiftAndAllelesAVX512, classifyAVX512, shiftAndPackedStripesAVX512}
+};
+
+/**
+* @var selectedKernels The kernel set in use, NULL until one is chosen. It is
+* atomic as patterns may be compiled by several threads at once.
+*/
+static atomic<const KernelSet *> selectedKernels(NULL);
+
+/**
+* Can the processor run a kernel set?
+*
+* @param k The index of the set in kernelSets
+*/
+static bool isSupported(const unsigned int k)
+{
+    __builtin_cpu_init();
+    switch (k) {
+        case 0:
+            return true;
+        case 1:
+            return __builtin_cpu_supports("avx2");
+        case 2:
+            return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+    }
+    return false;
+}
+
+/**
+* Find the kernel set of an instruction set level
+*
+* @param name scalar, avx2 or avx512
+* @return NULL if the level is unknown or not supported by the processor
+*/
+static const KernelSet * findKernels(const string & name)
+{
+    for (unsigned int k = 0; k < sizeof(kernelSets) / sizeof(KernelSet); k++)
+    {
+        if (name == kernelSets[k].name) {
+            return isSupported(k) ? &kernelSets[k] : NULL;
+        }
+    }
+    return NULL;
+}
+
+/**
+* Choose the kernel set of the EDSM_ISA environment variable, or the fastest
+* set the processor supports
+*
+* @return The kernel set
+*/
+static const KernelSet * chooseKernels()
+{
+    const char * name = getenv("EDSM_ISA");
+    if (name != NULL)
+    {
+        const KernelSet * kernels = findKernels(name);
+        if (kernels != NULL) {
+            return kernels;
+        }
+        cerr << "Warning: Instruction set " << name << " is unknown or not supported, ignoring EDSM_ISA" << endl;
+    }
+    unsigned int k = sizeof(kernelSets) / sizeof(KernelSet) - 1;
+    while (!isSupported(k)) {
+        k--;
+    }
+    return &kernelSets[k];
+}
+
+/**
+* Force the kernel set of an instruction set level, e.g. for benchmarking. It
+* must be set before the patterns are compiled.
+*
+* @param name scalar, avx2 or avx512
+* @return false if the level is unknown or not supported by the processor
+*/
+bool setKernels(const string & name)
+{
+    const KernelSet * kernels = findKernels(name);
+    if (kernels == NULL) {
+        return false;
+    }
+    selectedKernels.store(kernels, memory_order_release);
+    return true;
+}
+
+/**
+* Get the kernel set in use. Unless one was forced with setKernels or the
+* EDSM_ISA environment variable, the fastest set the processor supports is
+* chosen on the first call.
+*
+* @return The kernel set
+*/
+const KernelSet & getKernels()
+{
+    const KernelSet * kernels = selectedKernels.load(memory_order_acquire);
+    if (kernels == NULL)
+    {
+        //the choice is made once even if several threads get here first, and
+        //a set forced in the meantime by setKernels wins
+        static const KernelSet * chosen = chooseKernels();
+        if (selectedKernels.compare_exchange_strong(kernels, chosen, memory_order_acq_rel)) {
+            kernels = chosen;
+        }
+    }
+    return *kernels;
+}
@@ -0,0 +1,192 @@
+/*
+    EDSM: Elastic Degenerate String Matching
+
+    Copyright (C) 2017 Chang Liu, Solon P. Pissis, Ahmad Retha and Fatima Vayani.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __KERNELS__
+#define __KERNELS__
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "bitvector.hpp"
+
+#define STRIPEMINLENGTH 4096
+#define MAXLANES 8
+#define STRIPEBNDMLENGTH 48
+
+struct StringView;
+
+/**
+ * Striped Shift-And over a long determinate string for a pattern of fewer than
+ * WORDSIZE characters. The string is cut into lanes stripes and lane k reads
+ * a[k * stride..k * stride + steps), all lanes advancing together. Every lane
+ * starts from the empty state, so a lane only finds occurrences lying entirely
+ * inside what it reads; the caller makes the stripes overlap by m - 1
+ * characters so no occurrence is missed.
+ *
+ * @param mask The transition table indexed by character: bit m - j set when P[j] = c
+ * @param start The bit of the empty prefix, bit m, injected before every character
+ * @param a The determinate string
+ * @param stride The distance between the first characters of two lanes
+ * @param steps The number of characters read by every lane
+ * @param hits The end positions in a of the occurrences found by every lane
+ */
+typedef void (*StripeKernel)(const WORD * mask, const WORD start, const char * a, const unsigned int stride, const unsigned int steps, std::vector<unsigned int> * hits);
+
+void shiftAndStripesScalar(const WORD * mask, const WORD start, const char * a, const unsigned int stride, const unsigned int steps, std::vector<unsigned int> * hits);
+
+void shiftAndStripesAVX2(const WORD * mask, const WORD start, const char * a, const unsigned int stride, const unsigned int steps, std::vector<unsigned int> * hits);
+
+void shiftAndStripesAVX512(const WORD * mask, const WORD start, const char * a, const unsigned int stride, const unsigned int steps, std::vector<unsigned int> * hits);
+
+/**
+ * Shift-And over all the strings of a degenerate segment for a pattern of fewer
+ * than WORDSIZE characters. Every string runs from the same incoming state B
+ * with the empty prefix injected before every character, so the final state of
+ * a string holds both the prefixes of P extended through it and the prefixes
+ * of P it ends with. The vector kernels load one string per lane and mask the
+ * lanes off as their strings end. An empty string is epsilon and leaves B as
+ * it is.
+ *
+ * @param mask The transition table indexed by character: bit m - j set when P[j] = c
+ * @param start The bit of the empty prefix, bit m, injected before every character
+ * @param B The state before the segment
+ * @param S The strings of the segment
+ * @param n The number of strings in S
+ * @param scratch A buffer the kernel may use to interleave the strings
+ * @param matchFound Set to true if P was found in any string
+ * @return The union of the final states of the strings
+ */
+typedef WORD (*AlleleKernel)(const WORD * mask, const WORD start, const WORD B, const StringView * S, const unsigned int n, std::vector<unsigned char> & scratch, bool & matchFound);
+
+WORD shiftAndAllelesScalar(const WORD * mask, const WORD start, const WORD B, const StringView * S, const unsigned int n, std::vector<unsigned char> & scratch, bool & matchFound);
+
+WORD shiftAndAllelesAVX2(const WORD * mask, const WORD start, const WORD B, const StringView * S, const unsigned int n, std::vector<unsigned char> & scratch, bool & matchFound);
+
+WORD shiftAndAllelesAVX512(const WORD * mask, const WORD start, const WORD B, const StringView * S, const unsigned int n, std::vector<unsigned char> & scratch, bool & matchFound);
+
+/**
+ * Striped Shift-And, as StripeKernel, over 2-bit packed bases: A = 0, C = 1,
+ * G = 2 and T = 3, base i in bits 2 * (i % 32) of packed[i / 32]. Every lane
+ * loads 32 bases at a time and looks their masks up by code, so the bases are
+ * never turned into characters. Lane k reads bases from + k * stride onwards.
+ *
+ * @param mask The transition table indexed by 2-bit code
+ * @param start The bit of the empty prefix, bit m, injected before every base
+ * @param packed The packed bases
+ * @param from The first base of the string
+ * @param stride The distance between the first bases of two lanes
+ * @param steps The number of bases read by every lane
+ * @param hits The end positions, from from, of the occurrences found by every lane
+ */
+typedef void (*PackedStripeKernel)(const WORD * mask, const WORD start, const WORD * packed, const size_t from, const unsigned int stride, const unsigned int steps, std::vector<unsigned int> * hits);
+
+void shiftAndPackedStripesScalar(const WORD * mask, const WORD start, const WORD * packed, const size_t from, const unsigned int stride, const unsigned int steps, std::vector<unsigned int> * hits);
+
+void shiftAndPackedStripesAVX2(const WORD * mask, const WORD start, const WORD * packed, const size_t from, const unsigned int stride, const unsigned int steps, std::vector<unsigned int> * hits);
+
+void shiftAndPackedStripesAVX512(const WORD * mask, const WORD start, const WORD * packed, const size_t from, const unsigned int stride, const unsigned int steps, std::vector<unsigned int> * hits);
+
+WORD shiftAndPacked(const WORD * mask, const WORD start, WORD D, const WORD * packed, const size_t from, const unsigned int length, std::vector<unsigned int> & hits);
+
+void unpackBases(const WORD * packed, const size_t from, const size_t length, char * out);
+
+/**
+ * The classes of the 64 characters of a block of EDS text, bit j standing for
+ * the j-th character. A character outside all the classes, e.g. a 'B', is
+ * invalid.
+ */
+struct CharClasses
+{
+    /**
+     * @var base The bases A, C, G, T and N in either case
+     */
+    WORD base;
+
+    /**
+     * @var lower The lower case (soft-masked) bases
+     */
+    WORD lower;
+
+    /**
+     * @var delim The delimiters '{', ',' and '}'
+     */
+    WORD delim;
+
+    /**
+     * @var skip The characters that are skipped: the epsilon symbol E and white space
+     */
+    WORD skip;
+};
+
+/**
+ * Classify the characters of the EDS text in blocks of 64
+ *
+ * @param t The text
+ * @param blocks The number of blocks of 64 characters to classify
+ * @param classes The classes of every block
+ */
+typedef void (*ClassifyKernel)(const char * t, const size_t blocks, CharClasses * classes);
+
+void classifyScalar(const char * t, const size_t blocks, CharClasses * classes);
+
+void classifyAVX2(const char * t, const size_t blocks, CharClasses * classes);
+
+void classifyAVX512(const char * t, const size_t blocks, CharClasses * classes);
+
+/**
+ * One implementation of every hot kernel for a given instruction set level.
+ * The set is chosen once at run time from what the processor supports, so a
+ * single binary runs everywhere and uses AVX2 or AVX-512 where they exist.
+ */
+struct KernelSet
+{
+    /**
+     * @var name The instruction set level: scalar, avx2 or avx512
+     */
+    const char * name;
+
+    /**
+     * @var stripes The striped Shift-And over long determinate segments
+     */
+    StripeKernel stripes;
+
+    /**
+     * @var lanes The number of stripes searched by stripes at once
+     */
+    unsigned int lanes;
+
+    /**
+     * @var alleles The Shift-And over all the strings of a degenerate segment
+     */
+    AlleleKernel alleles;
+
+    /**
+     * @var classify The character classification of the EDS tokenizer
+     */
+    ClassifyKernel classify;
+
+    /**
+     * @var packedStripes The striped Shift-And over 2-bit packed bases, with as many lanes as stripes
+     */
+    PackedStripeKernel packedStripes;
+};
+
+bool setKernels(const std::string & name);
+
+const KernelSet & getKernels();
+
+#endif
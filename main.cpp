@@ -16,68 +16,252 @@
 */
 
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <string>
 #include <vector>
 #include <fstream>
 #include <algorithm>
 #include "edsm.hpp"
-#include <Variant.h>
+#include "mappedfile.hpp"
+#include "tokenizer.hpp"
+#include "vcfreader.hpp"
+#include "pipeline.hpp"
+#include "reference.hpp"
+#include "binaryeds.hpp"
+#include "fmindex.hpp"
+#include "server.hpp"
+#include <htslib/thread_pool.h>
 
 using namespace std;
-using namespace vcflib;
-
-char BUFF[BUFFERSIZE];
-int BUFFLIMIT = 0;
-int POS = 0;
-
-/*
-* Buffered file reading char by char
-*
-* @param f opened file handle
-*/
-char getNextChar(ifstream & f)
-{
-    if (BUFFLIMIT == 0) {
-        f.read(BUFF, BUFFERSIZE);
-        BUFFLIMIT = f.gcount();
-        POS = 0;
-        if (BUFFLIMIT == 0) {
-            return '\0';
-        }
-    }
-    char c = BUFF[POS];
-    if (++POS == BUFFLIMIT) {
-        BUFFLIMIT = 0;
-    }
-    return c;
-}
 
 int main(int argc, char * argv[])
 {
     string help = "There are two ways to run Elastic Degenerate String Matching (EDSM) ---\n\
-    \tUsage: ./edsm seq.txt pattern\n\
-    \tUsage: ./edsm reference.fasta variants.vcf pattern";
+    \tUsage: ./edsm [options] seq.txt pattern\n\
+    \tUsage: ./edsm [options] reference.fasta variants.vcf pattern\n\
+    Several patterns can be searched for in one pass, separated by commas or one per line in a pattern file.\n\
+    The sequence file may also be a binary EDS file, written without a pattern by --convert ---\n\
+    \tUsage: ./edsm --convert seq.eds seq.txt\n\
+    \tUsage: ./edsm --convert seq.eds reference.fasta variants.vcf\n\
+    Or the input is held in memory and searched for the patterns sent to a Unix domain socket, one query per line ---\n\
+    \tUsage: ./edsm --serve edsm.sock seq.txt\n\
+    \tUsage: ./edsm --serve edsm.sock reference.fasta variants.vcf\n\
+    Options:\n\
+    \t--isa LEVEL\tForce the vector kernels to scalar, avx2 or avx512 instead of the fastest supported (or set EDSM_ISA)\n\
+    \t--threads N\tSearch with N threads and decompress BGZF compressed input with them (default 1)\n\
+    \t--convert FILE\tWrite the input to FILE as binary EDS instead of searching it\n\
+    \t--index\t\tWith --convert, also write an FM-index of FILE to FILE.fmi; with a binary EDS file, search its index\n\
+    \t--serve SOCKET\tAnswer queries sent to the Unix domain socket SOCKET until interrupted instead of searching";
+
+    //options may be given anywhere, the other arguments are positional
+    vector<string> args;
+    string isa = "";
+    int threads = 1;
+    string convert = "";
+    bool index = false;
+    string serve = "";
+    for (int a = 1; a < argc; a++)
+    {
+        if (strncmp("--isa=", argv[a], 6) == 0) {
+            isa = argv[a] + 6;
+        } else if (strcmp("--isa", argv[a]) == 0 && a + 1 < argc) {
+            isa = argv[++a];
+        } else if (strncmp("--threads=", argv[a], 10) == 0) {
+            threads = atoi(argv[a] + 10);
+        } else if (strcmp("--threads", argv[a]) == 0 && a + 1 < argc) {
+            threads = atoi(argv[++a]);
+        } else if (strncmp("--convert=", argv[a], 10) == 0) {
+            convert = argv[a] + 10;
+        } else if (strcmp("--convert", argv[a]) == 0 && a + 1 < argc) {
+            convert = argv[++a];
+        } else if (strncmp("--serve=", argv[a], 8) == 0) {
+            serve = argv[a] + 8;
+        } else if (strcmp("--serve", argv[a]) == 0 && a + 1 < argc) {
+            serve = argv[++a];
+        } else if (strcmp("--index", argv[a]) == 0) {
+            index = true;
+        } else {
+            args.push_back(argv[a]);
+        }
+    }
 
-    if (argc == 1 || (argc == 2 && (strcmp("--help", argv[1]) == 0 || strcmp("-h", argv[1]) == 0))) {
+    if (argc == 1 || (args.size() == 1 && (args[0] == "--help" || args[0] == "-h"))) {
         cout << help << endl;
         return 0;
     }
 
-    if (!(argc == 4 || argc == 3)) {
+    //a conversion or a server takes the input files only, a search the pattern after them
+    unsigned int inputs = (convert == "" && serve == "") ? args.size() - 1 : args.size();
+    if (args.size() == 0 || !(inputs == 1 || inputs == 2)) {
         cerr << "Invalid number of arguments!" << endl;
         cout << help << endl;
         return 1;
     }
 
-	//pattern p
-    string p;
-    if (argc == 3) {
-        p = argv[2];
-    } else {
-        p = argv[3];
+    if (threads < 1) {
+        cerr << "Error: The number of threads must be at least 1!" << endl;
+        return 1;
+    }
+
+    if (isa != "" && !setKernels(isa)) {
+        cerr << "Error: Instruction set " << isa << " is unknown or not supported by this processor!" << endl;
+        return 1;
     }
-    //if user is passing pattern file instead of literal pattern try to read the pattern from the file
+
+    //compressed input is decompressed by a pool of threads shared by all the files
+    htsThreadPool pool = {NULL, 0};
+    if (threads > 1) {
+        pool.pool = hts_tpool_init(threads);
+    }
+
+    if (convert != "" || serve != "")
+    {
+        //the segments go to the file, or to memory for a server, instead of the search
+        BinaryEDSWriter writer;
+        MappedFile eds;
+        bool binary = false;
+        //a server keeps every contig of a reference as a binary EDS image of its own
+        vector<string> names;
+        vector< vector<uint64_t> > images;
+        vector<size_t> sizes;
+        if (inputs == 2)
+        {
+            MappedFile rf;
+            vector<Contig> contigs;
+            if (!openContigs(args[0], rf, contigs, &pool)) {
+                cerr << "Error: Failed to open reference file!" << endl;
+                return 1;
+            }
+            if (convert != "" && contigs.size() != 1) {
+                cerr << "Error: Only a reference with a single contig can be converted!" << endl;
+                return 1;
+            }
+            for (auto & c : contigs)
+            {
+                VCFReader vf;
+                if (!vf.open(args[1], &pool, c.name)) {
+                    cerr << "Error: Failed to open variants file!" << endl;
+                    return 1;
+                }
+                bool fetched = (c.data == NULL);
+                if (fetched && !fetchContig(args[0], c, &pool)) {
+                    cerr << "Error: Failed to read contig " << c.name << " of the reference file!" << endl;
+                    return 1;
+                }
+                searchContig(c, vf, writer);
+                if (fetched) {
+                    releaseContig(c);
+                }
+                vf.close();
+                if (serve != "")
+                {
+                    names.push_back(c.name);
+                    images.push_back(vector<uint64_t>());
+                    sizes.push_back(writer.getImage(images.back()));
+                    writer = BinaryEDSWriter();
+                }
+            }
+            rf.close();
+        }
+        else
+        {
+            if (!eds.open(args[0], &pool, true)) {
+                cerr << "Error. Unable to open sequence file!" << endl;
+                return 1;
+            }
+            //a server reads binary EDS straight from the mapping
+            eds.fill(sizeof(BinaryEDSHeader));
+            binary = (serve != "" && BinaryEDS::isBinary(eds.getData(), eds.getSize()));
+            EDSTokenizer tokenizer(eds.getData(), binary ? 0 : eds.getSize(), &eds);
+            vector<StringView> views;
+            while (tokenizer.nextSegment(views)) {
+                writer.push(views.data(), views.size());
+            }
+            if (!eds.isComplete())
+            {
+                cerr << "Error: Failed to decompress sequence file!" << endl;
+                return 1;
+            }
+            if (!binary && tokenizer.getInvalid() < eds.getSize())
+            {
+                cerr << "Error: Invalid character '" << eds.getData()[tokenizer.getInvalid()] << "' at byte " << tokenizer.getInvalid() << " of the sequence file!" << endl;
+                return 1;
+            }
+        }
+        if (pool.pool != NULL) {
+            hts_tpool_destroy(pool.pool);
+        }
+
+        if (serve != "")
+        {
+            //the text stays in memory as binary EDS, searched once per batch of queries
+            if (inputs != 2)
+            {
+                names.push_back("");
+                images.push_back(vector<uint64_t>());
+                sizes.push_back(binary ? 0 : writer.getImage(images.back()));
+            }
+            QueryServer server(threads);
+            uint64_t segments = 0, bases = 0;
+            for (unsigned int k = 0; k < images.size(); k++)
+            {
+                const char * t = binary ? eds.getData() : (const char *) images[k].data();
+                size_t n = binary ? eds.getSize() : sizes[k];
+                BinaryEDS bin;
+                if (!bin.load(t, n)) {
+                    cerr << "Error: Corrupt binary EDS file!" << endl;
+                    return 1;
+                }
+                segments += bin.getSegments();
+                bases += bin.getBases();
+                server.addText(t, n, names[k]);
+            }
+            if (!server.listen(serve)) {
+                cerr << "Error: Failed to create socket " << serve << "!" << endl;
+                return 1;
+            }
+            cout << "Vector kernels: " << getKernels().name << endl;
+            cout << "Serving " << segments << " segments of " << bases << " bases";
+            if (inputs == 2) {
+                cout << " in " << images.size() << (images.size() == 1 ? " contig" : " contigs");
+            }
+            cout << " on " << serve << endl;
+            server.serve();
+            eds.close();
+            return 0;
+        }
+
+        eds.close();
+        if (!writer.save(convert)) {
+            cerr << "Error: Failed to write binary EDS file!" << endl;
+            return 1;
+        }
+        cout << "Wrote " << writer.getSegments() << " segments of " << writer.getBases() << " bases to " << convert << endl;
+        if (index)
+        {
+            //the index is built from the file just written, which it is searched with
+            MappedFile file;
+            BinaryEDS bin;
+            FMIndex fm;
+            if (!file.open(convert) || !bin.load(file.getData(), file.getSize()) || !fm.build(bin)) {
+                cerr << "Error: Failed to index binary EDS file!" << endl;
+                return 1;
+            }
+            if (!fm.save(convert + ".fmi")) {
+                cerr << "Error: Failed to write FM-index file!" << endl;
+                return 1;
+            }
+            cout << "Wrote the FM-index of " << bin.getStrings() << " strings to " << convert << ".fmi" << endl;
+            file.close();
+        }
+        return 0;
+    }
+
+    //pattern p, or several patterns separated by commas
+    string p = args[inputs];
+    //if user is passing pattern file instead of literal pattern try to read the pattern from the file,
+    //one pattern per line
     if (p.find('.') != string::npos) {
         ifstream pf(p.c_str(), ios::in);
         if (!pf.good()) {
@@ -88,260 +272,272 @@ int main(int argc, char * argv[])
         p = "";
         while(pf.get(c))
         {
-            if (!(c == '\0' || c == '\r' || c == '\n')) {
+            if (c == '\n') {
+                p += ',';
+            } else if (!(c == '\0' || c == '\r')) {
                 p += c;
             }
         }
         pf.close();
     }
+    vector<string> patterns;
+    size_t pStart = 0, pEnd;
+    do {
+        pEnd = p.find(',', pStart);
+        string q = p.substr(pStart, pEnd - pStart);
+        if (q.length() > 0) {
+            patterns.push_back(q);
+        }
+        pStart = pEnd + 1;
+    } while (pEnd != string::npos);
+    if (patterns.size() == 0) {
+        patterns.push_back("");
+    }
 
-    EDSM edsm(p);
-
-    cout << "EDSM-BV searching..." << endl << endl;
+    //the longest pattern decides how much overlap is kept when splitting long strings
+    unsigned int pLen = 0;
+    for (const auto & q : patterns) {
+        pLen = max(pLen, (unsigned int) q.length());
+    }
 
-    if (argc == 4)
-    {
-        string refName = argv[1];
-        ifstream rf(refName.c_str(), ios::in);
-        if (!rf.good()) {
-            cerr << "Error: Failed to open reference file!" << endl;
-            return 1;
-        }
+    EDSM edsm(patterns);
 
-        string vcfName = argv[2];
-        VariantCallFile vf;
-        vf.open(vcfName);
-        if (!vf.is_open()) {
-            cerr << "Error: Failed to open variants file!" << endl;
-            return 1;
-        }
+    cout << "Vector kernels: " << getKernels().name << endl;
+    if (index) {
+        cout << "FM-index searching..." << endl << endl;
+    } else {
+        cout << "EDSM-BV searching..." << endl << endl;
+    }
 
-        //initialize fasta file reading and segment creation helper variables
-        string tBuff = "";
-        tBuff.reserve(BUFFERSIZE + p.length());
-        char c;
-        unsigned int rfIdx = 1, vfIdx = 0, i = 0;
-        Segment segment;
+    //the share of their time the read, parse and search stages were busy, when
+    //the pipeline was used
+    double utilisation[3] = {-1, -1, -1};
 
-        //skip first line of fasta file
-        getline(rf, tBuff);
-        tBuff = "";
+    //the contigs of the reference and their matches
+    vector<Contig> contigs;
 
-        //create variables for reading through vcf records and looking for duplicates
-        Variant var(vf), vBuffer(vf), var2(vf);
-        bool hasMoreVariants = true;
-        Segment vAlleles;
+    //the index of a binary EDS file, when it is searched instead of the text
+    FMIndex fm;
 
-        //read first variant and possibly successive duplicates for the same position, removing duplicate alleles
-        hasMoreVariants = vf.getNextVariant(var);
-        if (hasMoreVariants)
-        {
-            vfIdx = (unsigned int) var.position;
-            for (const auto & a : var.alleles) {
-                if (a[0] != '<') {
-                    vAlleles.push_back(a);
-                }
-            }
-            while (true) {
-                hasMoreVariants = vf.getNextVariant(var2);
-                if (hasMoreVariants)
-                {
-                    if (var2.position == var.position) {
-                        for (const auto & a : var2.alt) {
-                            if (a[0] != '<') {
-                                vAlleles.push_back(a);
-                            }
-                        }
-                    } else {
-                        vBuffer = var2;
-                        break;
-                    }
-                }
-                else
-                {
-                    break;
-                }
-            }
+    if (index && inputs == 2)
+    {
+        cerr << "Error: Only a binary EDS file can be searched with its index!" << endl;
+        return 1;
+    }
+    else if (inputs == 2)
+    {
+        //every record of the reference is a contig with the variants of its name,
+        //read from the file or, with its indexes, a contig at a time
+        string refName = args[0];
+        MappedFile rf;
+        if (!openContigs(refName, rf, contigs, &pool)) {
+            cerr << "Error: Failed to open reference file!" << endl;
+            return 1;
         }
 
-        //go through the reference sequence
-        while ((c = getNextChar(rf)) != '\0')
+        string vcfName = args[1];
+        if (contigs.size() == 1)
         {
-            if (!(c == 'A' || c == 'C' || c == 'G' || c == 'T' || c == 'N')) {
-                continue;
+            //a single contig is searched by the pipeline with the variants of its
+            //name, or with all of them when the FASTA has no header to name it
+            VCFReader vf;
+            if (!vf.open(vcfName, &pool, contigs[0].name)) {
+                cerr << "Error: Failed to open variants file!" << endl;
+                return 1;
             }
-
-            if (rfIdx != vfIdx)
-            {
-                tBuff += c;
-                i++;
-                if (i >= BUFFERSIZE) {
-                    segment.clear();
-                    segment.push_back(tBuff);
-                    edsm.searchNextSegment(segment);
-                    tBuff = "";
-                    i = 0;
-                }
+            bool fetched = (contigs[0].data == NULL);
+            if (fetched && !fetchContig(refName, contigs[0], &pool)) {
+                cerr << "Error: Failed to read contig " << contigs[0].name << " of the reference file!" << endl;
+                return 1;
             }
-            else
-            {
-                segment.clear();
-                if (tBuff.length() > 0) {
-                    segment.push_back(tBuff);
-                    edsm.searchNextSegment(segment);
-                    tBuff = "";
-                }
-
-                //then search current variant
-                if (vAlleles.size() > 0) {
-                    edsm.searchNextSegment(vAlleles);
-                    vAlleles.clear();
-                }
-
-                //fetch the next variant to be searched for when its position comes up
-                if (vBuffer.alleles.size() > 0)
-                {
-                    vfIdx = (unsigned int) vBuffer.position;
-                    for (const auto & a : vBuffer.alleles) {
-                        if (a[0] != '<') {
-                            vAlleles.push_back(a);
-                        }
-                    }
-
-                    vBuffer.alleles.clear();
-
-                    while (true) {
-                        hasMoreVariants = vf.getNextVariant(var2);
-                        if (hasMoreVariants)
-                        {
-                            if (vfIdx == (unsigned int) var2.position) {
-                                for (const auto & a : var2.alt) {
-                                    if (a[0] != '<') {
-                                        vAlleles.push_back(a);
-                                    }
-                                }
-                            } else {
-                                vBuffer = var2;
-                                break;
-                            }
-                        }
-                        else
-                        {
-                            break;
-                        }
-                    }
-                }
+            Pipeline pipeline(edsm, contigs[0].data, contigs[0].length, threads);
+            pipeline.start();
+            searchContig(contigs[0], vf, pipeline);
+            pipeline.finish();
+            utilisation[0] = pipeline.getReadUtilisation();
+            utilisation[1] = pipeline.getParseUtilisation();
+            utilisation[2] = pipeline.getSearchUtilisation();
+            contigs[0].matches = edsm.getMatches();
+            contigs[0].matchPatterns = edsm.getMatchPatterns();
+            edsm.clearMatches();
+            if (fetched) {
+                releaseContig(contigs[0]);
             }
-
-            rfIdx++;
+            vf.close();
         }
-        if (tBuff.length() > 0)
-        {
-            segment.clear();
-            segment.push_back(tBuff);
-            edsm.searchNextSegment(segment);
-            tBuff = "";
+        else if (!searchContigs(contigs, refName, vcfName, edsm, threads, &pool)) {
+            return 1;
         }
 
         rf.close();
     }
+    else if (index)
+    {
+        //only the segments around the hits of the index are read from the file
+        MappedFile eds;
+        BinaryEDS bin;
+        if (!eds.open(args[0], &pool) || !bin.load(eds.getData(), eds.getSize())) {
+            cerr << "Error: Only a binary EDS file can be searched with its index!" << endl;
+            return 1;
+        }
+        if (!fm.load(args[0] + ".fmi") || !fm.isIndexOf(bin)) {
+            cerr << "Error: Failed to read FM-index file " << args[0] << ".fmi, written by --convert with --index!" << endl;
+            return 1;
+        }
+        if (!fm.search(bin, edsm)) {
+            cerr << "Error: Failed to search FM-index!" << endl;
+            return 1;
+        }
+        eds.close();
+    }
     else
     {
         //open sequence file
-        ifstream eds(argv[1], ios::in);
-        if (!eds.good()) {
+        MappedFile eds;
+        if (!eds.open(args[0], &pool, true)) {
             cerr << "Error. Unable to open sequence file!" << endl;
             return 1;
         }
 
-        //initialize variables required for searching
-        Segment tempSeg;
-        string x = "";
-        x.reserve(BUFFERSIZE + p.length());
-        char c = 0;
-        bool inDegSeg = false;
-        unsigned int i = 0, j = 0;
+        //binary EDS is read straight from its tables, without parsing, so a
+        //compressed one is decompressed first
+        BinaryEDS bin;
+        eds.fill(sizeof(BinaryEDSHeader));
+        bool binary = BinaryEDS::isBinary(eds.getData(), eds.getSize());
+        if (binary && (!eds.isComplete() || !bin.load(eds.getData(), eds.getSize()))) {
+            cerr << "Error: Corrupt binary EDS file!" << endl;
+            return 1;
+        }
 
-        //go through the sequence file
-        while ((c = getNextChar(eds)) != '\0')
+        //go through the sequence file: the strings of a segment are views into the
+        //mapping, epsilon being an empty string, and a BGZF file is decompressed
+        //by the read stage as the parser gets to it
+        EDSTokenizer tokenizer(eds.getData(), binary ? 0 : eds.getSize(), &eds);
+        vector<StringView> views;
+        Pipeline pipeline(edsm, eds.getData(), eds.getSize(), threads, binary ? NULL : &eds);
+        pipeline.start();
+        pipeline.waitFor(PIPELINEREADCHUNK);
+        if (binary)
         {
-            if (i == 0 && c == '{')
+            //determinate segments are searched as they are packed
+            PackedView run;
+            while (true)
             {
-                inDegSeg = true;
-            }
-            else if (c == ',')
-            {
-                tempSeg.push_back(x);
-                x = "";
-                j = 0;
-            }
-            else if (c == '}' || (c == '{' && i > 0))
-            {
-                if (x.length() > 0) {
-                    tempSeg.push_back(x);
-                    x = "";
-                    j = 0;
-                    edsm.searchNextSegment(tempSeg);
-                    tempSeg.clear();
+                if (bin.nextPackedSegment(run)) {
+                    pipeline.push(run);
+                } else if (bin.nextSegment(views)) {
+                    pipeline.push(views.data(), views.size());
+                } else {
+                    break;
                 }
-                inDegSeg = (c == '{');
+                pipeline.waitFor(bin.getPosition() + PIPELINEREADCHUNK);
             }
-            else if (c != '{')
+        }
+        else
+        {
+            while (tokenizer.nextSegment(views))
             {
-                switch (c) {
-                    case 'A':
-                    case 'C':
-                    case 'G':
-                    case 'T':
-                    case 'N':
-                    case EPSILON[0]:
-                        x += c;
-                        j++;
-                        if (!inDegSeg && j == BUFFERSIZE)
-                        {
-                            tempSeg.push_back(x);
-                            x = "";
-                            j = 0;
-                            edsm.searchNextSegment(tempSeg);
-                            tempSeg.clear();
-                        }
-                        else if (inDegSeg && j == (BUFFERSIZE + p.length()))
-                        {
-                            tempSeg.push_back(x.substr(0, BUFFERSIZE));
-                            x = x.substr(BUFFERSIZE - 1, p.length());
-                            j = p.length();
-                        }
-                        break;
-                }
+                pipeline.push(views.data(), views.size());
+                pipeline.waitFor(tokenizer.getPosition() + PIPELINEREADCHUNK);
             }
-            i++;
         }
-        if (x != "") {
-            tempSeg.push_back(x);
-            edsm.searchNextSegment(tempSeg);
-            x = "";
-            tempSeg.clear();
+        pipeline.finish();
+        utilisation[0] = pipeline.getReadUtilisation();
+        utilisation[1] = pipeline.getParseUtilisation();
+        utilisation[2] = pipeline.getSearchUtilisation();
+        if (binary && !bin.isComplete())
+        {
+            cerr << "Error: Corrupt binary EDS file!" << endl;
+            return 1;
+        }
+        if (!eds.isComplete())
+        {
+            cerr << "Error: Failed to decompress sequence file!" << endl;
+            return 1;
+        }
+        if (!binary && tokenizer.getInvalid() < eds.getSize())
+        {
+            cerr << "Error: Invalid character '" << eds.getData()[tokenizer.getInvalid()] << "' at byte " << tokenizer.getInvalid() << " of the sequence file!" << endl;
+            return 1;
         }
 
         eds.close();
     }
 
+    if (pool.pool != NULL) {
+        hts_tpool_destroy(pool.pool);
+    }
+
 
     //output results
 
-    cout << "No. determinate bases (f): " << edsm.getf() << endl;
-    cout << "No. degenerate bases (F): " << edsm.getF() << endl;
-    cout << "No. determinate segments (d): " << edsm.getd() << endl;
-    cout << "No. degenerate segments (D): " << edsm.getD() << endl;
-    cout << "No. strings processed shorter than pattern (N'): " << edsm.getNp() << endl;
-    cout << "EDSM-BV processing time: " << edsm.getDuration() << "s." << endl << endl;
+    if (index)
+    {
+        //the index reads no more of the text than the segments around its hits
+        cout << "Segments searched for crossing matches: " << fm.getVerified() << endl;
+        cout << "FM-index processing time: " << fm.getDuration() << "s." << endl;
+        cout << endl;
+    }
+    else
+    {
+        cout << "No. determinate bases (f): " << edsm.getf() << endl;
+        cout << "No. degenerate bases (F): " << edsm.getF() << endl;
+        cout << "No. determinate segments (d): " << edsm.getd() << endl;
+        cout << "No. degenerate segments (D): " << edsm.getD() << endl;
+        cout << "No. strings processed shorter than pattern (N'): " << edsm.getNp() << endl;
+        cout << "Allocations while searching: " << edsm.getAllocations() << endl;
+        cout << "EDSM-BV processing time: " << edsm.getDuration() << "s." << endl;
+        if (utilisation[0] >= 0) {
+            cout << "Stage utilisation (read/parse/search): " << (int) (100 * utilisation[0] + 0.5) << "%/" << (int) (100 * utilisation[1] + 0.5) << "%/" << (int) (100 * utilisation[2] + 0.5) << "%" << endl;
+        }
+        cout << endl;
+    }
+
+    //the matches of a reference are kept by contig
+    size_t found = edsm.getMatches().size();
+    for (const auto & c : contigs) {
+        found += c.matches.size();
+    }
 
-    if (edsm.getMatches().size() >= 1)
+    if (found >= 1)
     {
-        cout << "Matches found: " << edsm.getMatches().size() << endl << endl;
-        cout << "Positions" << endl << "---------" << endl;
-        for (const auto & a : edsm.getMatches()) {
-            cout << a << endl;
+        cout << "Matches found: " << found << endl << endl;
+        if (contigs.size() > 0)
+        {
+            //tag every match with its contig, and the pattern it belongs to if there are several
+            if (patterns.size() == 1) {
+                cout << "Contig\tPositions" << endl << "------\t---------" << endl;
+            } else {
+                cout << "Contig\tPositions\tPatterns" << endl << "------\t---------\t--------" << endl;
+            }
+            for (const auto & c : contigs)
+            {
+                for (unsigned int k = 0; k < c.matches.size(); k++)
+                {
+                    cout << c.name << "\t" << c.matches[k];
+                    if (patterns.size() > 1) {
+                        cout << "\t" << patterns[c.matchPatterns[k]];
+                    }
+                    cout << endl;
+                }
+            }
+        }
+        else if (patterns.size() == 1)
+        {
+            cout << "Positions" << endl << "---------" << endl;
+            for (const auto & a : edsm.getMatches()) {
+                cout << a << endl;
+            }
+        }
+        else
+        {
+            //tag every match with the pattern it belongs to
+            vector<int> positions = edsm.getMatches();
+            vector<unsigned int> tags = edsm.getMatchPatterns();
+            cout << "Positions\tPatterns" << endl << "---------\t--------" << endl;
+            for (unsigned int k = 0; k < positions.size(); k++) {
+                cout << positions[k] << "\t" << patterns[tags[k]] << endl;
+            }
         }
     }
     else
@@ -0,0 +1,349 @@
+/*
+    EDSM: Elastic Degenerate String Matching
+
+    Copyright (C) 2017 Chang Liu, Solon P. Pissis, Ahmad Retha and Fatima Vayani.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+#include <string>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "mappedfile.hpp"
+
+using namespace std;
+
+/**
+* Add up the decompressed lengths of the blocks of a BGZF file. Every block
+* starts with a gzip header holding its compressed size and ends with its
+* decompressed size, so only two small reads per 64 KiB block are needed.
+*
+* @param fd The open file
+* @param size The length of the file in bytes
+* @param length Set to the decompressed length of the file
+* @return Is the file made of BGZF blocks only?
+*/
+static bool bgzfLength(const int fd, const size_t size, size_t & length)
+{
+    static const unsigned char magic[16] = {31, 139, 8, 4, 0, 0, 0, 0, 0, 255, 6, 0, 66, 67, 2, 0};
+    unsigned char header[18], footer[4];
+    size_t offset = 0, block;
+
+    length = 0;
+    while (offset < size)
+    {
+        //the modification time and OS bytes of the header vary, the rest does not
+        if (pread(fd, header, 18, offset) != 18 || memcmp(header, magic, 4) != 0 || memcmp(header + 10, magic + 10, 6) != 0) {
+            return false;
+        }
+        block = (header[16] | (header[17] << 8)) + 1;
+        if (offset + block > size || pread(fd, footer, 4, offset + block - 4) != 4) {
+            return false;
+        }
+        length += footer[0] | (footer[1] << 8) | (footer[2] << 16) | ((size_t) footer[3] << 24);
+        offset += block;
+    }
+
+    return true;
+}
+
+/**
+* @constructor
+*/
+MappedFile::MappedFile() : available(0)
+{
+    this->data = NULL;
+    this->size = 0;
+    this->mapped = false;
+    this->fp = NULL;
+    this->complete = false;
+}
+
+/**
+* @destructor
+*/
+MappedFile::~MappedFile()
+{
+    this->close();
+}
+
+/**
+* Map a file into memory, or read it if it cannot be mapped. A gzip or BGZF
+* compressed file is decompressed into memory instead, all at once unless it
+* is a BGZF file opened as a stream.
+*
+* @param name The path of the file
+* @param pool The threads that decompress BGZF blocks, or NULL to decompress on this thread
+* @param streamed Decompress a BGZF file only as fill() asks for it, rather than now?
+* @return Was the file opened?
+*/
+bool MappedFile::open(const string & name, htsThreadPool * pool, const bool streamed)
+{
+    struct stat st;
+    unsigned char magic[2];
+    size_t length;
+
+    this->close();
+
+    int fd = ::open(name.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+        if (pread(fd, magic, 2, 0) == 2 && magic[0] == 0x1f && magic[1] == 0x8b)
+        {
+            if (!bgzfLength(fd, st.st_size, length)) {
+                return this->decompress(fd, pool);
+            }
+            if (!this->stream(fd, length, pool)) {
+                return false;
+            }
+            return streamed || this->isComplete();
+        }
+
+        void * p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED)
+        {
+            madvise(p, st.st_size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+            madvise(p, st.st_size, MADV_HUGEPAGE);
+#endif
+            this->data = (const char *) p;
+            this->size = st.st_size;
+            this->mapped = true;
+            this->available = this->size;
+            this->complete = true;
+            ::close(fd);
+            return true;
+        }
+    }
+
+    //not a regular file, or mmap is not available: BGZF reads plain data as it is
+    return this->decompress(fd, pool);
+}
+
+/**
+* Get a BGZF file ready to be decompressed into an anonymous mapping of its
+* decompressed length. Pages of the mapping only take memory once written.
+*
+* @param fd The open file, closed with the BGZF file
+* @param length The decompressed length of the file
+* @param pool The threads that decompress BGZF blocks, or NULL to decompress on the calling thread
+* @return Could the file be opened and the mapping made?
+*/
+bool MappedFile::stream(const int fd, const size_t length, htsThreadPool * pool)
+{
+    void * p = NULL;
+
+    if (length > 0)
+    {
+        p = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (p == MAP_FAILED)
+        {
+            ::close(fd);
+            return false;
+        }
+    }
+
+    this->fp = bgzf_dopen(fd, "r");
+    if (this->fp == NULL)
+    {
+        ::close(fd);
+        if (p != NULL) {
+            munmap(p, length);
+        }
+        return false;
+    }
+    if (pool != NULL && pool->pool != NULL) {
+        bgzf_thread_pool(this->fp, pool->pool, pool->qsize);
+    }
+
+    this->data = (const char *) p;
+    this->size = length;
+    this->mapped = (p != NULL);
+    this->available = 0;
+    this->complete = false;
+
+    //there is nothing to fill, so check there is nothing left either
+    if (length == 0)
+    {
+        char extra;
+        this->complete = (bgzf_read(this->fp, &extra, 1) == 0);
+        bgzf_close(this->fp);
+        this->fp = NULL;
+    }
+
+    return true;
+}
+
+/**
+* Decompress a streamed file up to p, unless that much is already available.
+* Any thread may call it: one decompresses while the others wait for it. The
+* file is closed in the same step that makes all of it available.
+*
+* @param p The number of bytes wanted from the start of the file
+* @return The number of bytes available, min(p, getSize()) or more unless the file is corrupt
+*/
+size_t MappedFile::fill(const size_t p)
+{
+    size_t ready = this->available.load(memory_order_acquire);
+    char extra;
+    ssize_t got = 0;
+
+    if (ready >= min(p, this->size)) {
+        return ready;
+    }
+
+    lock_guard<mutex> hold(this->lock);
+    ready = this->available.load(memory_order_relaxed);
+    while (this->fp != NULL && ready < min(p, this->size))
+    {
+        got = bgzf_read(this->fp, (char *) this->data + ready, min(this->size - ready, (size_t) DECOMPRESSCHUNK));
+        if (got <= 0) {
+            break;
+        }
+        ready += got;
+        this->available.store(ready, memory_order_release);
+    }
+
+    //a file holding more or less than its blocks say is corrupt
+    if (this->fp != NULL && (got <= 0 || ready == this->size))
+    {
+        this->complete = (ready == this->size && bgzf_read(this->fp, &extra, 1) == 0);
+        bgzf_close(this->fp);
+        this->fp = NULL;
+    }
+
+    return ready;
+}
+
+/**
+* Was the whole file read? A streamed file that is not done yet is
+* decompressed to the end first.
+*
+* @return false if the file was cut short or corrupt
+*/
+bool MappedFile::isComplete()
+{
+    this->fill(this->size);
+    lock_guard<mutex> hold(this->lock);
+    return this->complete;
+}
+
+/**
+* Read a whole file through BGZF, which also reads plain gzip and uncompressed
+* data, into an anonymous mapping that at least doubles whenever it is full.
+* The mapping grows in place or by having its pages moved, never copied, so
+* the file only takes its own length in memory.
+*
+* @param fd The open file, closed when done
+* @param pool The threads that decompress BGZF blocks, or NULL to decompress on this thread
+* @return Was the file read?
+*/
+bool MappedFile::decompress(const int fd, htsThreadPool * pool)
+{
+    size_t used = 0, capacity = DECOMPRESSCHUNK;
+    ssize_t got;
+    void * p, * q;
+
+    BGZF * fp = bgzf_dopen(fd, "r");
+    if (fp == NULL)
+    {
+        ::close(fd);
+        return false;
+    }
+    if (pool != NULL && pool->pool != NULL) {
+        bgzf_thread_pool(fp, pool->pool, pool->qsize);
+    }
+
+    p = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED)
+    {
+        bgzf_close(fp);
+        return false;
+    }
+    while ((got = bgzf_read(fp, (char *) p + used, capacity - used)) > 0)
+    {
+        used += got;
+        if (used == capacity)
+        {
+            q = mremap(p, capacity, 2 * capacity, MREMAP_MAYMOVE);
+            if (q == MAP_FAILED)
+            {
+                got = -1;
+                break;
+            }
+            p = q;
+            capacity *= 2;
+        }
+    }
+    bgzf_close(fp);
+
+    //give back the pages past the end
+    if (got < 0 || used == 0 || (q = mremap(p, capacity, used, 0)) == MAP_FAILED)
+    {
+        munmap(p, capacity);
+        this->available = 0;
+        this->complete = (got == 0 && used == 0);
+        return this->complete;
+    }
+    this->data = (const char *) p;
+    this->size = used;
+    this->mapped = true;
+    this->available = used;
+    this->complete = true;
+
+    return true;
+}
+
+/**
+* Unmap the contents of the file
+*/
+void MappedFile::close()
+{
+    if (this->fp != NULL)
+    {
+        bgzf_close(this->fp);
+        this->fp = NULL;
+    }
+    if (this->mapped) {
+        munmap((void *) this->data, this->size);
+    }
+    this->data = NULL;
+    this->size = 0;
+    this->mapped = false;
+    this->available = 0;
+    this->complete = false;
+}
+
+/**
+* Get the contents of the file. A streamed file is only filled as far as
+* fill() has been asked to.
+*/
+const char * MappedFile::getData() const
+{
+    return this->data;
+}
+
+/**
+* Get the length of the file in bytes
+*/
+size_t MappedFile::getSize() const
+{
+    return this->size;
+}
@@ -0,0 +1,106 @@
+/*
+    EDSM: Elastic Degenerate String Matching
+
+    Copyright (C) 2017 Chang Liu, Solon P. Pissis, Ahmad Retha and Fatima Vayani.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __MAPPEDFILE__
+#define __MAPPEDFILE__
+
+#include <cstdlib>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <htslib/hts.h>
+#include <htslib/bgzf.h>
+
+#define DECOMPRESSCHUNK (1 << 24)
+
+/**
+ * A whole input file made available as one block of memory. Regular files are
+ * mapped read-only and the kernel is told they will be read sequentially, so
+ * segments can be searched straight out of the mapping.
+ *
+ * A BGZF compressed file, as written by bgzip, gets its decompressed length
+ * from the headers of its blocks and is decompressed into an anonymous mapping
+ * of exactly that size, its blocks inflated by a thread pool. Opened as a
+ * stream, it is only decompressed as far as fill() is asked to, so it can be
+ * parsed and searched while the rest is still being decompressed. Anything
+ * else, plain gzip or a pipe, is decompressed whole into an anonymous mapping
+ * grown in place.
+ */
+class MappedFile
+{
+protected:
+
+    /**
+     * @var data The contents of the file
+     */
+    const char * data;
+
+    /**
+     * @var size The length of the file in bytes
+     */
+    size_t size;
+
+    /**
+     * @var mapped Is data a mapping?
+     */
+    bool mapped;
+
+    /**
+     * @var fp The BGZF file being decompressed into data, NULL once it is done
+     */
+    BGZF * fp;
+
+    /**
+     * @var available The number of bytes of data decompressed so far
+     */
+    std::atomic<size_t> available;
+
+    /**
+     * @var complete Was the whole file decompressed, to the length of its blocks?
+     */
+    bool complete;
+
+    /**
+     * @var lock Held while decompressing more of the file
+     */
+    std::mutex lock;
+
+    bool stream(const int fd, const size_t length, htsThreadPool * pool);
+
+    bool decompress(const int fd, htsThreadPool * pool);
+
+public:
+
+    MappedFile();
+
+    ~MappedFile();
+
+    bool open(const std::string & name, htsThreadPool * pool = NULL, const bool streamed = false);
+
+    size_t fill(const size_t p);
+
+    bool isComplete();
+
+    void close();
+
+    const char * getData() const;
+
+    size_t getSize() const;
+
+};
+
+#endif
@@ -0,0 +1,225 @@
+/*
+    EDSM: Elastic Degenerate String Matching
+
+    Copyright (C) 2017 Chang Liu, Solon P. Pissis, Ahmad Retha and Fatima Vayani.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __PATTERNINDEX__
+#define __PATTERNINDEX__
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "bitvector.hpp"
+
+/**
+ * The substring index of a short pattern P used by occVector: the suffix
+ * automaton of P stored as flat arrays. Reading a string a from the initial
+ * state takes |a| table lookups and ends in a state whose end-position
+ * bit-vector encodes every occurrence of a in P.
+ *
+ * The automaton has fewer than 2m states, so for the patterns EDSM-BV handles
+ * the whole index stays in cache and is built in linear time.
+ *
+ * Most alleles are only a few bases long, so the answers for every string of
+ * length up to k are also precomputed in a table indexed by the 2-bit packed
+ * encoding of the string, turning those lookups into a single load.
+ */
+template<class BV>
+class PatternIndex
+{
+protected:
+
+    /**
+     * @var m The length of P
+     */
+    unsigned int m;
+
+    /**
+     * @var next The transitions of the automaton: next[q * 4 + code(c)], -1 if there is none
+     */
+    std::vector<int> next;
+
+    /**
+     * @var EP The end positions of the substrings of every state: bit m - e for an occurrence ending at P[e]
+     */
+    std::vector<BV> EP;
+
+    /**
+     * @var code Maps the characters A, C, G and T to 0..3 and any other character to -1
+     */
+    int code[256];
+
+    /**
+     * @var k The length of the longest strings answered by table
+     */
+    unsigned int k;
+
+    /**
+     * @var table The occVector of every string of length 1 to k: the string of length l
+     * with 2-bit packed encoding x is at table[(4^l - 4) / 3 + x]
+     */
+    std::vector<BV> table;
+
+    void buildTable(const std::string & P)
+    {
+        unsigned int i, l;
+        WORD x;
+
+        this->table.assign(((1ul << (2 * this->k + 2)) - 4) / 3, BV());
+        for (i = 0; i < this->m; i++)
+        {
+            x = 0;
+            for (l = 1; l <= this->k && i + l <= this->m; l++)
+            {
+                x = (x << 2) | this->code[(unsigned char)P[i + l - 1]];
+                this->table[((1ul << (2 * l)) - 4) / 3 + x].set(this->m - i);
+            }
+        }
+    }
+
+public:
+
+    PatternIndex()
+    {
+        this->m = 0;
+        this->k = 0;
+    }
+
+    /**
+     * Build the suffix automaton of P and the table of the short strings
+     *
+     * @param P A determinate pattern consisting of A, C, G or T characters
+     * @param k The length of the longest strings to precompute, capped at m - 1
+     * since occVector is only used for strings shorter than P
+     */
+    void build(const std::string & P, const unsigned int k)
+    {
+        unsigned int e, h, size;
+        int c, p, q, clone, cur, last;
+
+        for (h = 0; h < 256; h++) {
+            this->code[h] = -1;
+        }
+        this->code[(int)'A'] = 0;
+        this->code[(int)'C'] = 1;
+        this->code[(int)'G'] = 2;
+        this->code[(int)'T'] = 3;
+
+        this->m = P.length();
+        this->next.assign(4 * (2 * this->m + 1), -1);
+        this->EP.assign(2 * this->m + 1, BV());
+        std::vector<int> link(2 * this->m + 1, -1);
+        std::vector<unsigned int> len(2 * this->m + 1, 0);
+
+        size = 1;
+        last = 0;
+        for (e = 0; e < this->m; e++)
+        {
+            c = this->code[(unsigned char)P[e]];
+            cur = size++;
+            len[cur] = len[last] + 1;
+            this->EP[cur].set(this->m - e);
+            for (p = last; p != -1 && this->next[p * 4 + c] == -1; p = link[p]) {
+                this->next[p * 4 + c] = cur;
+            }
+            if (p == -1)
+            {
+                link[cur] = 0;
+            }
+            else
+            {
+                q = this->next[p * 4 + c];
+                if (len[p] + 1 == len[q])
+                {
+                    link[cur] = q;
+                }
+                else
+                {
+                    clone = size++;
+                    len[clone] = len[p] + 1;
+                    for (h = 0; h < 4; h++) {
+                        this->next[clone * 4 + h] = this->next[q * 4 + h];
+                    }
+                    link[clone] = link[q];
+                    for (; p != -1 && this->next[p * 4 + c] == q; p = link[p]) {
+                        this->next[p * 4 + c] = clone;
+                    }
+                    link[q] = clone;
+                    link[cur] = clone;
+                }
+            }
+            last = cur;
+        }
+        this->next.resize(4 * size);
+        this->EP.resize(size);
+
+        //the end positions of a state are the union of those of the states linking to it,
+        //so push them up the suffix links from the longest states down
+        std::vector<unsigned int> count(this->m + 2, 0), order(size);
+        for (h = 0; h < size; h++) {
+            count[len[h] + 1]++;
+        }
+        for (h = 1; h < count.size(); h++) {
+            count[h] += count[h - 1];
+        }
+        for (h = 0; h < size; h++) {
+            order[count[len[h]]++] = h;
+        }
+        for (h = size - 1; h > 0; h--) {
+            this->EP[link[order[h]]] |= this->EP[order[h]];
+        }
+
+        this->k = std::min(k, this->m - 1);
+        this->buildTable(P);
+    }
+
+    /**
+     * Encode the positions of P where a occurs: bit m - i for an occurrence starting at P[i]
+     *
+     * @param a The substring to find in P
+     * @param n The length of a
+     * @return A bit-vector, empty if a does not occur in P
+     */
+    BV occVector(const char * a, const unsigned int n) const
+    {
+        int q = 0, c;
+        if (n <= this->k && n > 0)
+        {
+            WORD x = 0;
+            for (unsigned int j = 0; j < n; j++)
+            {
+                c = this->code[(unsigned char)a[j]];
+                if (c == -1) {
+                    return BV();
+                }
+                x = (x << 2) | c;
+            }
+            return this->table[((1ul << (2 * n)) - 4) / 3 + x];
+        }
+        for (unsigned int j = 0; j < n; j++)
+        {
+            c = this->code[(unsigned char)a[j]];
+            if (c == -1 || (q = this->next[q * 4 + c]) == -1) {
+                return BV();
+            }
+        }
+        if (n == 0) {
+            return BV();
+        }
+        return this->EP[q] << (n - 1);
+    }
+};
+
+#endif
@@ -0,0 +1,559 @@
+/*
+    EDSM: Elastic Degenerate String Matching
+
+    Copyright (C) 2017 Chang Liu, Solon P. Pissis, Ahmad Retha and Fatima Vayani.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include "pipeline.hpp"
+
+using namespace std;
+
+/**
+* The wall clock time
+*
+* @return The time in seconds
+*/
+static double wallTime()
+{
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+* Add an item to a ring, waiting for room if it is full
+*
+* @param ring The ring
+* @param x The item
+* @param idle The time spent waiting is added to it
+*/
+template <class T>
+static void waitPush(SPSCRing<T> & ring, const T & x, double & idle)
+{
+    if (ring.tryPush(x)) {
+        return;
+    }
+    double start = wallTime();
+    while (!ring.tryPush(x)) {
+        this_thread::yield();
+    }
+    idle += wallTime() - start;
+}
+
+/**
+* Take an item from a ring, waiting for one if it is empty
+*
+* @param ring The ring
+* @param x Set to the item
+* @param idle The time spent waiting is added to it
+*/
+template <class T>
+static void waitPop(SPSCRing<T> & ring, T & x, double & idle)
+{
+    if (ring.tryPop(x)) {
+        return;
+    }
+    double start = wallTime();
+    while (!ring.tryPop(x)) {
+        this_thread::yield();
+    }
+    idle += wallTime() - start;
+}
+
+/**
+* Copy a string into the blocks of a batch
+*
+* @param b The batch
+* @param a The string
+* @return Where the copy is
+*/
+static const char * store(SegmentBatch & b, const StringView & a)
+{
+    if (b.block == b.blocks.size() || b.blocks[b.block].length() + a.length > b.blocks[b.block].capacity())
+    {
+        //start a new block, which may be reserved as it holds no strings yet
+        if (b.block < b.blocks.size() && b.blocks[b.block].length() > 0) {
+            b.block++;
+        }
+        if (b.block == b.blocks.size()) {
+            b.blocks.emplace_back();
+        }
+        b.blocks[b.block].reserve(max((size_t) PIPELINEBATCHBYTES, (size_t) a.length));
+    }
+
+    string & s = b.blocks[b.block];
+    size_t offset = s.length();
+    s.append(a.data, a.length);
+    b.copied += a.length;
+
+    return s.data() + offset;
+}
+
+/**
+* Empty a batch, keeping its memory
+*
+* @param b The batch
+*/
+static void clearBatch(SegmentBatch & b)
+{
+    b.strings.clear();
+    b.sizes.clear();
+    b.runs.clear();
+    for (auto & s : b.blocks) {
+        s.clear();
+    }
+    b.block = 0;
+    b.copied = 0;
+    b.bases = 0;
+    b.prime.clear();
+    b.pos = 0;
+    b.matches.clear();
+    b.matchPatterns.clear();
+}
+
+/**
+* Send on a determinate segment of packed bases as characters, for sinks that
+* cannot take packed bases
+*
+* @param a The segment, not empty
+*/
+void SegmentSink::push(const PackedView & a)
+{
+    string bases(a.length, 'N');
+    StringView s;
+    unpackView(a, &bases[0]);
+    s.data = bases.data();
+    s.length = a.length;
+    this->push(&s, 1);
+}
+
+/**
+* @constructor
+* @param edsm The searcher
+*/
+DirectSink::DirectSink(EDSM & edsm) : edsm(edsm)
+{
+}
+
+/**
+* Search a segment
+*
+* @param S The strings of the segment, an empty string being epsilon
+* @param n The number of strings in S
+*/
+void DirectSink::push(const StringView * S, const unsigned int n)
+{
+    this->edsm.searchNextSegment(S, n);
+}
+
+/**
+* Search a segment
+*
+* @param S The strings of the segment, EPSILON standing for the empty string
+*/
+void DirectSink::push(const Segment & S)
+{
+    this->edsm.searchNextSegment(S);
+}
+
+/**
+* Search a determinate segment of packed bases
+*
+* @param a The segment, not empty
+*/
+void DirectSink::push(const PackedView & a)
+{
+    this->edsm.searchPackedSegment(a);
+}
+
+/**
+* @constructor
+* @param edsm The searcher the segments are fed to
+* @param t The input, which must stay in memory until the pipeline has finished
+* @param n The length of t
+* @param threads The number of search threads, each searching whole batches with its own EDSM when there are several
+* @param source The file t is decompressed into, by the read stage, or NULL if t is all in memory
+*/
+Pipeline::Pipeline(EDSM & edsm, const char * t, const size_t n, const unsigned int threads, MappedFile * source) : edsm(edsm), chunks(PIPELINEREADAHEAD), stop(false)
+{
+    unsigned int k, count, capacity;
+
+    this->t = t;
+    this->n = n;
+    this->source = source;
+    this->m = 0;
+    for (const auto & q : edsm.getPatterns()) {
+        this->m = max(this->m, (unsigned int) q.length());
+    }
+    this->pos = 0;
+    this->sent = 0;
+    this->received = 0;
+    this->available = 0;
+    this->running = false;
+    this->checksum = 0;
+    this->begin = 0;
+    for (k = 0; k < 2; k++)
+    {
+        this->idle[k] = 0;
+        this->elapsed[k] = 0;
+    }
+    this->searchIdle.assign(max(threads, 1u), 0);
+    this->searchElapsed.assign(max(threads, 1u), 0);
+
+    //enough batches to keep every search thread busy while the parser fills the next
+    count = max((unsigned int) PIPELINEBATCHES, 2 * threads + 1);
+    for (capacity = 1; capacity <= count; capacity *= 2);
+    for (k = 0; k < max(threads, 1u); k++)
+    {
+        this->full.emplace_back(new SPSCRing<SegmentBatch *>(capacity));
+        this->empty.emplace_back(new SPSCRing<SegmentBatch *>(capacity));
+        if (threads > 1) {
+            this->workers.emplace_back(new EDSM(edsm.getCompiledPattern()));
+        }
+    }
+
+    this->batches.resize(count);
+    for (auto & b : this->batches)
+    {
+        clearBatch(b);
+        this->spare.push_back(&b);
+    }
+    this->batch = this->spare.back();
+    this->spare.pop_back();
+}
+
+/**
+* @destructor
+*/
+Pipeline::~Pipeline()
+{
+    this->finish();
+}
+
+/**
+* Start the read and search stages, the caller becoming the parse stage
+*/
+void Pipeline::start()
+{
+    this->begin = wallTime();
+    this->running = true;
+    this->reader = thread(&Pipeline::read, this);
+    for (unsigned int k = 0; k < this->full.size(); k++) {
+        this->searchers.push_back(thread(&Pipeline::search, this, k));
+    }
+}
+
+/**
+* The read stage: touch every page of the input a chunk at a time, so the
+* parser finds it in memory, or decompress the chunk, and hand the ends of
+* the chunks to the parser
+*/
+void Pipeline::read()
+{
+    const volatile char * v = this->t;
+    double start = wallTime(), wait;
+    size_t p, q, end;
+    unsigned char sum = 0;
+
+    for (p = 0; p < this->n && !this->stop.load(memory_order_relaxed); p = end)
+    {
+        end = min(this->n, p + PIPELINEREADCHUNK);
+        if (this->source != NULL) {
+            this->source->fill(end);
+        } else {
+            for (q = p; q < end; q += PIPELINEPAGE) {
+                sum += v[q];
+            }
+        }
+        if (!this->chunks.tryPush(end))
+        {
+            wait = wallTime();
+            while (!this->chunks.tryPush(end) && !this->stop.load(memory_order_relaxed)) {
+                this_thread::yield();
+            }
+            this->idle[0] += wallTime() - wait;
+        }
+    }
+    this->checksum = sum;
+    this->elapsed[0] = wallTime() - start;
+}
+
+/**
+* Wait until the reader has paged in the input up to p
+*
+* @param p The position
+*/
+void Pipeline::waitFor(const size_t p)
+{
+    size_t end;
+
+    while (this->available < min(p, this->n))
+    {
+        waitPop(this->chunks, end, this->idle[1]);
+        this->available = end;
+    }
+}
+
+/**
+* A search thread: search the segments of every batch in order and give the
+* batch back to the parser
+*
+* @param k The number of the thread
+*/
+void Pipeline::search(const unsigned int k)
+{
+    EDSM & e = this->workers.empty() ? this->edsm : *this->workers[k];
+    double start = wallTime();
+    SegmentBatch * b;
+    StringView a;
+    unsigned int j, r;
+
+    while (true)
+    {
+        waitPop(*this->full[k], b, this->searchIdle[k]);
+        if (b == NULL) {
+            break;
+        }
+
+        //a batch searched on its own starts from the characters before it
+        if (!this->workers.empty())
+        {
+            a.data = b->prime.data();
+            a.length = b->prime.length();
+            e.primeWith(a, b->pos);
+        }
+
+        j = 0;
+        r = 0;
+        for (const auto & s : b->sizes)
+        {
+            if (s == PACKEDSEGMENT)
+            {
+                e.searchPackedSegment(b->runs[r++]);
+                continue;
+            }
+            e.searchNextSegment(b->strings.data() + j, s);
+            j += s;
+        }
+
+        if (!this->workers.empty())
+        {
+            b->matches = e.getMatches();
+            b->matchPatterns = e.getMatchPatterns();
+            e.clearMatches();
+        }
+        waitPush(*this->empty[k], b, this->searchIdle[k]);
+    }
+    this->searchElapsed[k] = wallTime() - start;
+}
+
+/**
+* Take back the oldest batch handed to the search threads, adding its matches
+* to those found so far
+*
+* @param idle The time spent waiting is added to it
+* @return The batch, emptied
+*/
+SegmentBatch * Pipeline::recycle(double & idle)
+{
+    SegmentBatch * b;
+
+    waitPop(*this->empty[this->received % this->empty.size()], b, idle);
+    this->received++;
+    if (!this->workers.empty()) {
+        this->edsm.addMatches(b->matches, b->matchPatterns);
+    }
+    clearBatch(*b);
+
+    return b;
+}
+
+/**
+* Hand the batch being filled to the next search thread and take an empty one
+*/
+void Pipeline::flush()
+{
+    if (this->batch->sizes.empty()) {
+        return;
+    }
+    waitPush(*this->full[this->sent % this->full.size()], this->batch, this->idle[1]);
+    this->sent++;
+
+    if (this->spare.empty())
+    {
+        this->batch = this->recycle(this->idle[1]);
+    }
+    else
+    {
+        this->batch = this->spare.back();
+        this->spare.pop_back();
+    }
+    this->batch->pos = this->pos;
+}
+
+/**
+* Queue a segment for searching. Strings that do not point into the input are
+* copied, so S may be overwritten as soon as this returns.
+*
+* @param S The strings of the segment, an empty string being epsilon
+* @param n The number of strings in S
+*/
+void Pipeline::push(const StringView * S, const unsigned int n)
+{
+    bool isDeterminateSegment = (n == 1 && S[0].length > 0);
+    StringView a;
+
+    for (unsigned int s = 0; s < n; s++)
+    {
+        a = S[s];
+        if (a.length > 0 && (a.data < this->t || a.data >= this->t + this->n)) {
+            a.data = store(*this->batch, a);
+        }
+        this->batch->strings.push_back(a);
+        this->batch->bases += a.length;
+    }
+    this->batch->sizes.push_back(n);
+    this->pos += isDeterminateSegment ? S[0].length : 1;
+
+    if (this->workers.empty())
+    {
+        if (this->batch->strings.size() + this->batch->runs.size() >= PIPELINEBATCHSTRINGS || this->batch->copied >= PIPELINEBATCHBYTES) {
+            this->flush();
+        }
+    }
+    else if (isDeterminateSegment && S[0].length >= this->m && this->batch->bases >= PIPELINEBATCHBASES)
+    {
+        //a safe cut: the next batch only needs the last m characters of S
+        this->flush();
+        this->batch->prime.assign(S[0].data + S[0].length - this->m, this->m);
+    }
+}
+
+/**
+* Queue a segment for searching
+*
+* @param S The strings of the segment, EPSILON standing for the empty string
+*/
+void Pipeline::push(const Segment & S)
+{
+    this->views.resize(S.size());
+    for (unsigned int s = 0; s < S.size(); s++)
+    {
+        this->views[s].data = S[s].data();
+        this->views[s].length = (S[s] == EPSILON) ? 0 : S[s].length();
+    }
+    this->push(this->views.data(), S.size());
+}
+
+/**
+* Queue a determinate segment of packed bases for searching. The bases are not
+* copied: they must stay in memory until the pipeline has finished, as the
+* input does.
+*
+* @param a The segment, not empty
+*/
+void Pipeline::push(const PackedView & a)
+{
+    this->batch->runs.push_back(a);
+    this->batch->sizes.push_back(PACKEDSEGMENT);
+    this->batch->bases += a.length;
+    this->pos += a.length;
+
+    if (this->workers.empty())
+    {
+        if (this->batch->strings.size() + this->batch->runs.size() >= PIPELINEBATCHSTRINGS) {
+            this->flush();
+        }
+    }
+    else if (a.length >= this->m && this->batch->bases >= PIPELINEBATCHBASES)
+    {
+        //a safe cut, primed with the last m bases of a
+        PackedView tail = a;
+        tail.from = a.from + a.length - this->m;
+        tail.length = this->m;
+        tail.exceptions = findRun(a.exceptions, a.n, tail.from);
+        tail.n = a.n - (tail.exceptions - a.exceptions) / 2;
+        this->flush();
+        this->batch->prime.assign(this->m, 'N');
+        unpackView(tail, &this->batch->prime[0]);
+    }
+}
+
+/**
+* Search what is left, stop the read and search stages and merge the results
+* of the search threads
+*/
+void Pipeline::finish()
+{
+    double wait = 0;
+    unsigned int k;
+
+    if (!this->running) {
+        return;
+    }
+    this->flush();
+    for (k = 0; k < this->full.size(); k++) {
+        waitPush(*this->full[k], (SegmentBatch *) NULL, this->idle[1]);
+    }
+    this->elapsed[1] = wallTime() - this->begin;
+    this->stop = true;
+
+    while (this->received < this->sent) {
+        this->spare.push_back(this->recycle(wait));
+    }
+    for (auto & s : this->searchers) {
+        s.join();
+    }
+    this->reader.join();
+    for (auto & w : this->workers) {
+        this->edsm.addCounters(*w);
+    }
+    this->running = false;
+}
+
+/**
+* Get the share of its running time the read stage was busy
+*/
+double Pipeline::getReadUtilisation() const
+{
+    return (this->elapsed[0] > 0) ? 1 - this->idle[0] / this->elapsed[0] : 0;
+}
+
+/**
+* Get the share of its running time the parse stage was busy
+*/
+double Pipeline::getParseUtilisation() const
+{
+    return (this->elapsed[1] > 0) ? 1 - this->idle[1] / this->elapsed[1] : 0;
+}
+
+/**
+* Get the share of their running time the search threads were busy, on average
+*/
+double Pipeline::getSearchUtilisation() const
+{
+    double idle = 0, elapsed = 0;
+
+    for (unsigned int k = 0; k < this->searchElapsed.size(); k++)
+    {
+        idle += this->searchIdle[k];
+        elapsed += this->searchElapsed[k];
+    }
+
+    return (elapsed > 0) ? 1 - idle / elapsed : 0;
+}
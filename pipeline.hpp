@@ -0,0 +1,427 @@
+/*
+    EDSM: Elastic Degenerate String Matching
+
+    Copyright (C) 2017 Chang Liu, Solon P. Pissis, Ahmad Retha and Fatima Vayani.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __PIPELINE__
+#define __PIPELINE__
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include "edsm.hpp"
+#include "mappedfile.hpp"
+
+#define PIPELINEBATCHES 8
+#define PIPELINEBATCHSTRINGS 4096
+#define PIPELINEBATCHBYTES (4 * BUFFERSIZE)
+//the bases of a batch dealt to a search thread, and the bytes of input paged in at a time
+#define PIPELINEBATCHBASES (1 << 22)
+#define PIPELINEREADCHUNK (1 << 22)
+#define PIPELINEREADAHEAD 16
+#define PIPELINEPAGE 4096
+#define PACKEDSEGMENT ((unsigned int) -1)
+
+/**
+ * A bounded lock-free queue between exactly one producer thread and one
+ * consumer thread. The producer only writes tail and the consumer only writes
+ * head, padded onto their own cache lines, so neither ever takes a lock.
+ */
+template <class T>
+class SPSCRing
+{
+protected:
+
+    /**
+     * @var items The slots, a power of two of them
+     */
+    std::vector<T> items;
+
+    /**
+     * @var mask The number of slots minus 1
+     */
+    size_t mask;
+
+    char padding1[64];
+
+    /**
+     * @var head The number of items popped so far
+     */
+    std::atomic<size_t> head;
+
+    char padding2[64];
+
+    /**
+     * @var tail The number of items pushed so far
+     */
+    std::atomic<size_t> tail;
+
+    char padding3[64];
+
+public:
+
+    /**
+     * @constructor
+     * @param capacity The number of items the ring holds, a power of two
+     */
+    SPSCRing(const size_t capacity) : items(capacity), mask(capacity - 1), head(0), tail(0)
+    {
+    }
+
+    /**
+     * Add an item unless the ring is full
+     *
+     * @param x The item
+     * @return Was the item added?
+     */
+    bool tryPush(const T & x)
+    {
+        size_t k = this->tail.load(std::memory_order_relaxed);
+        if (k - this->head.load(std::memory_order_acquire) > this->mask) {
+            return false;
+        }
+        this->items[k & this->mask] = x;
+        this->tail.store(k + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Take the oldest item unless the ring is empty
+     *
+     * @param x Set to the item
+     * @return Was an item taken?
+     */
+    bool tryPop(T & x)
+    {
+        size_t k = this->head.load(std::memory_order_relaxed);
+        if (k == this->tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        x = this->items[k & this->mask];
+        this->head.store(k + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+/**
+ * The segments handed from the parser to the search in one go. Strings that
+ * do not point into the input itself are copied into blocks, which never move
+ * once made, so the views stay valid however many strings are added.
+ */
+struct SegmentBatch
+{
+    /**
+     * @var strings The strings of the segments
+     */
+    std::vector<StringView> strings;
+
+    /**
+     * @var sizes The number of strings of every segment, PACKEDSEGMENT for the next segment of runs
+     */
+    std::vector<unsigned int> sizes;
+
+    /**
+     * @var runs The determinate segments of packed bases, which point into the input
+     */
+    std::vector<PackedView> runs;
+
+    /**
+     * @var blocks The copies of the strings that are not in the input
+     */
+    std::deque<std::string> blocks;
+
+    /**
+     * @var block The block being filled
+     */
+    unsigned int block;
+
+    /**
+     * @var copied The number of bytes copied into blocks
+     */
+    size_t copied;
+
+    /**
+     * @var bases The total length of the strings
+     */
+    size_t bases;
+
+    /**
+     * @var prime The last m characters before the batch, when it is searched on its own
+     */
+    std::string prime;
+
+    /**
+     * @var pos The position of the first segment of the batch
+     */
+    unsigned int pos;
+
+    /**
+     * @var matches The matches found in the batch when it is searched on its own
+     */
+    std::vector<int> matches;
+
+    /**
+     * @var matchPatterns The index of the pattern of each match in matches
+     */
+    std::vector<unsigned int> matchPatterns;
+};
+
+/**
+ * Where a parser sends the segments it reads, to be searched
+ */
+class SegmentSink
+{
+public:
+
+    virtual ~SegmentSink()
+    {
+    }
+
+    virtual void push(const StringView * S, const unsigned int n) = 0;
+
+    virtual void push(const Segment & S) = 0;
+
+    virtual void push(const PackedView & a);
+
+    /**
+     * Wait until the input up to p can be read without stalling
+     *
+     * @param p The position in the input
+     */
+    virtual void waitFor(const size_t p)
+    {
+    }
+};
+
+/**
+ * Searches every segment right away on the calling thread, e.g. in a thread
+ * that is one of many already
+ */
+class DirectSink : public SegmentSink
+{
+protected:
+
+    /**
+     * @var edsm The searcher
+     */
+    EDSM & edsm;
+
+public:
+
+    DirectSink(EDSM & edsm);
+
+    void push(const StringView * S, const unsigned int n);
+
+    void push(const Segment & S);
+
+    void push(const PackedView & a);
+
+};
+
+/**
+ * Runs the search as three stages on their own threads: reading pages the
+ * input in a chunk at a time ahead of the parser, or decompresses it when it
+ * is a streamed BGZF file, parsing (on the calling thread) turns the input
+ * into segments, and searching feeds them to EDSM.
+ * Chunks and batches of segments are handed on through SPSC rings, and a
+ * full ring makes the stage before it wait, so no stage runs away from the
+ * others. Every stage counts the time it spends waiting on a ring, which
+ * gives its utilisation: the bottleneck is the stage close to 100%.
+ *
+ * With several search threads the text is cut into batches of at least
+ * PIPELINEBATCHBASES bases, only after a determinate segment of at least
+ * m characters: the search state there depends on nothing but its last m
+ * characters, so every batch can be searched by its own EDSM primed with
+ * them. The batches are dealt out in turn and taken back in the same order,
+ * which merges their matches in position order.
+ */
+class Pipeline : public SegmentSink
+{
+protected:
+
+    /**
+     * @var edsm The searcher, which gets all the matches and counters
+     */
+    EDSM & edsm;
+
+    /**
+     * @var t The input
+     */
+    const char * t;
+
+    /**
+     * @var n The length of t
+     */
+    size_t n;
+
+    /**
+     * @var source The file t is decompressed into by the read stage, or NULL if t is all in memory
+     */
+    MappedFile * source;
+
+    /**
+     * @var m The length of the longest pattern
+     */
+    unsigned int m;
+
+    /**
+     * @var pos The position of the next segment pushed
+     */
+    unsigned int pos;
+
+    /**
+     * @var batches All the batches, each either free, being filled, queued or searched
+     */
+    std::vector<SegmentBatch> batches;
+
+    /**
+     * @var spare The batches ready to be filled
+     */
+    std::vector<SegmentBatch *> spare;
+
+    /**
+     * @var batch The batch being filled by the parser
+     */
+    SegmentBatch * batch;
+
+    /**
+     * @var sent The number of batches handed to the search threads
+     */
+    unsigned long int sent;
+
+    /**
+     * @var received The number of batches taken back from the search threads
+     */
+    unsigned long int received;
+
+    /**
+     * @var chunks The ends of the chunks of the input paged in by the reader
+     */
+    SPSCRing<size_t> chunks;
+
+    /**
+     * @var full The batches waiting to be searched by every search thread, NULL marking the end
+     */
+    std::vector<std::unique_ptr<SPSCRing<SegmentBatch *>>> full;
+
+    /**
+     * @var empty The batches every search thread has searched
+     */
+    std::vector<std::unique_ptr<SPSCRing<SegmentBatch *>>> empty;
+
+    /**
+     * @var workers The EDSM of every search thread when there are several
+     */
+    std::vector<std::unique_ptr<EDSM>> workers;
+
+    /**
+     * @var available The input up to here has been paged in, as seen by the parser
+     */
+    size_t available;
+
+    /**
+     * @var stop Tells the reader that the parser is done
+     */
+    std::atomic<bool> stop;
+
+    /**
+     * @var running Are the reader and search threads running?
+     */
+    bool running;
+
+    /**
+     * @var reader The thread of the read stage
+     */
+    std::thread reader;
+
+    /**
+     * @var searchers The threads of the search stage
+     */
+    std::vector<std::thread> searchers;
+
+    /**
+     * @var views The views of a Segment being pushed
+     */
+    std::vector<StringView> views;
+
+    /**
+     * @var checksum What the reader read, kept so the reads are not optimised away
+     */
+    unsigned char checksum;
+
+    /**
+     * @var begin When the pipeline was started, in seconds
+     */
+    double begin;
+
+    /**
+     * @var idle The time in seconds the read and parse stages spent waiting
+     */
+    double idle[2];
+
+    /**
+     * @var elapsed The time in seconds the read and parse stages ran for
+     */
+    double elapsed[2];
+
+    /**
+     * @var searchIdle The time in seconds every search thread spent waiting
+     */
+    std::vector<double> searchIdle;
+
+    /**
+     * @var searchElapsed The time in seconds every search thread ran for
+     */
+    std::vector<double> searchElapsed;
+
+    void read();
+
+    void search(const unsigned int k);
+
+    void flush();
+
+    SegmentBatch * recycle(double & idle);
+
+public:
+
+    Pipeline(EDSM & edsm, const char * t, const size_t n, const unsigned int threads = 1, MappedFile * source = NULL);
+
+    ~Pipeline();
+
+    void start();
+
+    void waitFor(const size_t p);
+
+    void push(const StringView * S, const unsigned int n);
+
+    void push(const Segment & S);
+
+    void push(const PackedView & a);
+
+    void finish();
+
+    double getReadUtilisation() const;
+
+    double getParseUtilisation() const;
+
+    double getSearchUtilisation() const;
+
+};
+
+#endif
@@ -0,0 +1,443 @@
+/*
+    EDSM: Elastic Degenerate String Matching
+
+    Copyright (C) 2017 Chang Liu, Solon P. Pissis, Ahmad Retha and Fatima Vayani.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cctype>
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <unistd.h>
+#include "reference.hpp"
+
+using namespace std;
+
+/**
+* The lookup table of the bases A, C, G, T and N
+*/
+struct BaseTable
+{
+    bool isBase[256];
+
+    BaseTable()
+    {
+        memset(this->isBase, 0, sizeof(this->isBase));
+        this->isBase[(int)'A'] = this->isBase[(int)'C'] = this->isBase[(int)'G'] = this->isBase[(int)'T'] = this->isBase[(int)'N'] = true;
+    }
+};
+
+/**
+* Get the lookup table of the bases, built once for all threads
+*
+* @return Is a character a base?
+*/
+static const bool * baseTable()
+{
+    static const BaseTable table;
+    return table.isBase;
+}
+
+/*
+* Take the next string of at most limit bases from t[i..n), skipping anything
+* that is not a base. The string points straight into t unless skipped
+* characters, such as line breaks, split it; its bases are then compacted
+* onto the end of buffer.
+*
+* @param t The input
+* @param i The position to start from, advanced past what was read
+* @param n The end of the input
+* @param limit The maximum number of bases to take
+* @param buffer Where split strings are compacted, with enough capacity that it is never reallocated
+* @return The string
+*/
+static StringView nextBases(const char * t, size_t & i, const size_t n, const size_t limit, string & buffer)
+{
+    const bool * IS_BASE = baseTable();
+    StringView a;
+    size_t k = 0, r, start;
+    bool compact = false;
+
+    a.data = t + i;
+    while (i < n && k < limit)
+    {
+        //take a run of bases at once
+        r = i;
+        while (r < n && r - i < limit - k && IS_BASE[(unsigned char) t[r]]) {
+            r++;
+        }
+        if (r > i)
+        {
+            if (compact) {
+                buffer.append(t + i, r - i);
+            } else if (k == 0) {
+                a.data = t + i;
+            }
+            k += r - i;
+            i = r;
+            continue;
+        }
+
+        if (k > 0 && !compact)
+        {
+            compact = true;
+            start = buffer.length();
+            buffer.append(a.data, k);
+            a.data = buffer.data() + start;
+        }
+        i++;
+    }
+    a.length = k;
+
+    return a;
+}
+
+/**
+* Split a FASTA file into its records. A file without any header is taken as
+* a single unnamed contig.
+*
+* @param t The contents of the file
+* @param n The length of t
+* @return The contigs in the order of the file
+*/
+vector<Contig> findContigs(const char * t, const size_t n)
+{
+    vector<Contig> contigs;
+    const char * p = t, * e = t + n, * eol, * next;
+    size_t k;
+
+    if (n == 0 || t[0] != '>')
+    {
+        contigs.push_back(Contig());
+        contigs.back().data = t;
+        contigs.back().length = n;
+        return contigs;
+    }
+
+    while (p < e)
+    {
+        //the header names the contig up to the first white space
+        eol = (const char *) memchr(p, '\n', e - p);
+        eol = (eol == NULL) ? e : eol;
+        for (k = 1; p + k < eol && !isspace((unsigned char) p[k]); k++);
+        contigs.push_back(Contig());
+        contigs.back().name.assign(p + 1, k - 1);
+
+        //the sequence runs up to the next header
+        p = min(eol + 1, e);
+        next = p;
+        while ((next = (const char *) memchr(next, '>', e - next)) != NULL && next[-1] != '\n') {
+            next++;
+        }
+        next = (next == NULL) ? e : next;
+        contigs.back().data = p;
+        contigs.back().length = next - p;
+        p = next;
+    }
+
+    return contigs;
+}
+
+/**
+* Load the .fai and .gzi indexes of a compressed FASTA file, its BGZF blocks to
+* be decompressed by a thread pool
+*
+* @param name The path of the FASTA file
+* @param pool The threads that decompress BGZF blocks, or NULL to decompress on the calling thread
+* @return The index, or NULL if it could not be loaded
+*/
+static faidx_t * loadIndex(const string & name, htsThreadPool * pool)
+{
+    faidx_t * fai = fai_load3(name.c_str(), NULL, NULL, 0);
+    if (fai != NULL && pool != NULL && pool->pool != NULL) {
+        fai_thread_pool(fai, pool->pool, pool->qsize);
+    }
+    return fai;
+}
+
+/**
+* Get the contigs of a FASTA file. A gzip compressed file with both its .fai
+* and .gzi indexes, as written by bgzip and samtools faidx, is not read at all:
+* its contigs are listed from the index, with no data, and every contig is
+* fetched on its own when it is searched. Any other file is read into rf and
+* split into its records.
+*
+* @param name The path of the FASTA file
+* @param rf The file, opened unless the contigs come from the index
+* @param contigs Set to the contigs in the order of the file
+* @param pool The threads that decompress BGZF blocks, or NULL
+* @return Could the file be read?
+*/
+bool openContigs(const string & name, MappedFile & rf, vector<Contig> & contigs, htsThreadPool * pool)
+{
+    char magic[2] = {0, 0};
+    faidx_t * fai = NULL;
+    int k, length;
+
+    ifstream f(name.c_str(), ios::in | ios::binary);
+    f.read(magic, 2);
+    f.close();
+    if (magic[0] == '\x1f' && magic[1] == '\x8b' && access((name + ".fai").c_str(), R_OK) == 0 && access((name + ".gzi").c_str(), R_OK) == 0) {
+        fai = fai_load3(name.c_str(), NULL, NULL, 0);
+    }
+    if (fai == NULL)
+    {
+        if (!rf.open(name, pool)) {
+            return false;
+        }
+        contigs = findContigs(rf.getData(), rf.getSize());
+        return true;
+    }
+
+    contigs.clear();
+    for (k = 0; k < faidx_nseq(fai); k++)
+    {
+        contigs.push_back(Contig());
+        contigs.back().name = faidx_iseq(fai, k);
+        length = faidx_seq_len(fai, faidx_iseq(fai, k));
+        contigs.back().data = NULL;
+        contigs.back().length = max(length, 0);
+    }
+    fai_destroy(fai);
+
+    return true;
+}
+
+/**
+* Read the bases of a contig listed from the index of its FASTA file. Only the
+* BGZF blocks of the contig are decompressed.
+*
+* @param fai The index, used by one thread at a time
+* @param c The contig, which gets its bases and their number
+* @return Could the contig be read?
+*/
+bool fetchContig(const faidx_t * fai, Contig & c)
+{
+    int length = 0;
+    char * s;
+
+    if (c.length == 0)
+    {
+        c.data = (const char *) calloc(1, 1);
+        return true;
+    }
+    s = faidx_fetch_seq(fai, c.name.c_str(), 0, c.length - 1, &length);
+    if (s == NULL || length < 0)
+    {
+        free(s);
+        return false;
+    }
+    c.data = s;
+    c.length = length;
+
+    return true;
+}
+
+/**
+* Read the bases of a contig listed from the index of its FASTA file, loading
+* the index for it alone
+*
+* @param name The path of the FASTA file
+* @param c The contig, which gets its bases and their number
+* @param pool The threads that decompress BGZF blocks, or NULL to decompress on the calling thread
+* @return Could the contig be read?
+*/
+bool fetchContig(const string & name, Contig & c, htsThreadPool * pool)
+{
+    faidx_t * fai = loadIndex(name, pool);
+    if (fai == NULL) {
+        return false;
+    }
+    bool fetched = fetchContig(fai, c);
+    fai_destroy(fai);
+    return fetched;
+}
+
+/**
+* Free the bases of a contig read through the index of its FASTA file
+*
+* @param c The contig
+*/
+void releaseContig(Contig & c)
+{
+    free((void *) c.data);
+    c.data = NULL;
+}
+
+/**
+* Search a contig with its variants: the reference base at the position of a
+* variant site is replaced by a degenerate segment of the alleles of the site
+*
+* @param c The contig
+* @param vf The variant sites of the contig, positions counted from 1
+* @param sink Where the segments are sent to be searched
+*/
+void searchContig(const Contig & c, VCFReader & vf, SegmentSink & sink)
+{
+    const char * t = c.data;
+    size_t n = c.length, i = 0, limit;
+    string tBuff = "";
+    tBuff.reserve(BUFFERSIZE);
+    unsigned int rfIdx = 1, vfIdx = 0;
+
+    //determinate segments are searched straight out of the contig, or out of
+    //tBuff when line breaks split them
+    StringView segment;
+
+    //read the first variant site, all the records for its position merged
+    Segment vAlleles;
+    if (!vf.nextSite(vfIdx, vAlleles)) {
+        vfIdx = 0;
+    }
+
+    //go through the reference sequence
+    while (i < n)
+    {
+        sink.waitFor(i + PIPELINEREADCHUNK);
+        if (rfIdx != vfIdx)
+        {
+            limit = BUFFERSIZE;
+            if (vfIdx > rfIdx) {
+                limit = min(limit, (size_t) (vfIdx - rfIdx));
+            }
+            tBuff.clear();
+            segment = nextBases(t, i, n, limit, tBuff);
+            if (segment.length > 0) {
+                sink.push(&segment, 1);
+                rfIdx += segment.length;
+            }
+        }
+        else
+        {
+            //the reference base at the position of the variant is replaced by its alleles
+            tBuff.clear();
+            if (nextBases(t, i, n, 1, tBuff).length == 0) {
+                break;
+            }
+
+            //then search current variant
+            if (vAlleles.size() > 0) {
+                sink.push(vAlleles);
+                vAlleles.clear();
+            }
+
+            //fetch the next variant to be searched for when its position comes up
+            if (!vf.nextSite(vfIdx, vAlleles)) {
+                vfIdx = 0;
+            }
+
+            rfIdx++;
+        }
+    }
+}
+
+/**
+* Search several contigs at once, each with the variants of its own name. The
+* threads take the contigs largest first from a shared queue, so a thread that
+* finishes early takes the next one and the run takes about as long as the
+* largest contig. The counters of the search end up in edsm and the matches
+* in every contig. Contigs listed from the index of the reference are fetched
+* by the thread that searches them and freed once searched, so only the
+* contigs being searched are in memory.
+*
+* @param contigs The contigs
+* @param refName The path of the reference, which contigs without data are fetched from
+* @param vcfName The path of the VCF file, best indexed with tabix
+* @param edsm The searcher whose patterns are searched for
+* @param threads The number of threads
+* @param pool The threads that decompress BGZF blocks, or NULL
+* @return Could the contigs and the variants file be read?
+*/
+bool searchContigs(vector<Contig> & contigs, const string & refName, const string & vcfName, EDSM & edsm, const unsigned int threads, htsThreadPool * pool)
+{
+    vector<unsigned int> order(contigs.size());
+    vector<unique_ptr<EDSM>> searchers;
+    vector<thread> team;
+    atomic<unsigned int> next(0);
+    atomic<bool> failed(false);
+    unsigned int k;
+
+    for (k = 0; k < contigs.size(); k++) {
+        order[k] = k;
+    }
+    stable_sort(order.begin(), order.end(), [&](const unsigned int a, const unsigned int b) {
+        return contigs[a].length > contigs[b].length;
+    });
+
+    auto work = [&](EDSM & e) {
+        VCFReader vf;
+        DirectSink sink(e);
+        StringView none = {NULL, 0};
+        faidx_t * fai = NULL;
+        unsigned int j;
+        while ((j = next++) < contigs.size() && !failed)
+        {
+            Contig & c = contigs[order[j]];
+            bool fetched = (c.data == NULL);
+            if (fetched && fai == NULL) {
+                fai = loadIndex(refName, pool);
+            }
+            if (fetched && (fai == NULL || !fetchContig(fai, c)))
+            {
+                cerr << "Error: Failed to read contig " << c.name << " of the reference file!" << endl;
+                failed = true;
+                break;
+            }
+            if (!vf.open(vcfName, pool, c.name))
+            {
+                cerr << "Error: Failed to open variants file!" << endl;
+                if (fetched) {
+                    releaseContig(c);
+                }
+                failed = true;
+                break;
+            }
+            e.primeWith(none, 0);
+            searchContig(c, vf, sink);
+            c.matches = e.getMatches();
+            c.matchPatterns = e.getMatchPatterns();
+            e.clearMatches();
+            if (fetched) {
+                releaseContig(c);
+            }
+        }
+        vf.close();
+        if (fai != NULL) {
+            fai_destroy(fai);
+        }
+    };
+
+    for (k = 0; k < max(1u, min(threads, (unsigned int) contigs.size())); k++) {
+        searchers.emplace_back(new EDSM(edsm.getCompiledPattern()));
+    }
+    for (k = 1; k < searchers.size(); k++) {
+        team.push_back(thread(work, ref(*searchers[k])));
+    }
+    work(*searchers[0]);
+    for (auto & h : team) {
+        h.join();
+    }
+
+    for (auto & s : searchers) {
+        edsm.addCounters(*s);
+    }
+
+    return !failed;
+}
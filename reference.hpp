@@ -0,0 +1,77 @@
+/*
+    EDSM: Elastic Degenerate String Matching
+
+    Copyright (C) 2017 Chang Liu, Solon P. Pissis, Ahmad Retha and Fatima Vayani.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __REFERENCE__
+#define __REFERENCE__
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <htslib/hts.h>
+#include <htslib/faidx.h>
+#include "edsm.hpp"
+#include "mappedfile.hpp"
+#include "pipeline.hpp"
+#include "vcfreader.hpp"
+
+/**
+ * One record of a FASTA reference and the matches found in it
+ */
+struct Contig
+{
+    /**
+     * @var name The name of the contig, the header up to the first white space
+     */
+    std::string name;
+
+    /**
+     * @var data The sequence lines of the record, line breaks included, or
+     * NULL until the contig is fetched through the index of the file
+     */
+    const char * data;
+
+    /**
+     * @var length The length of data in bytes, the number of bases before the contig is fetched
+     */
+    size_t length;
+
+    /**
+     * @var matches The positions of the matches found in the contig
+     */
+    std::vector<int> matches;
+
+    /**
+     * @var matchPatterns The index of the pattern of each match in matches
+     */
+    std::vector<unsigned int> matchPatterns;
+};
+
+std::vector<Contig> findContigs(const char * t, const size_t n);
+
+bool openContigs(const std::string & name, MappedFile & rf, std::vector<Contig> & contigs, htsThreadPool * pool);
+
+bool fetchContig(const faidx_t * fai, Contig & c);
+
+bool fetchContig(const std::string & name, Contig & c, htsThreadPool * pool);
+
+void releaseContig(Contig & c);
+
+void searchContig(const Contig & c, VCFReader & vf, SegmentSink & sink);
+
+bool searchContigs(std::vector<Contig> & contigs, const std::string & refName, const std::string & vcfName, EDSM & edsm, const unsigned int threads, htsThreadPool * pool);
+
+#endif
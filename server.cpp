@@ -0,0 +1,442 @@
+/*
+    EDSM: Elastic Degenerate String Matching
+
+    Copyright (C) 2017 Chang Liu, Solon P. Pissis, Ahmad Retha and Fatima Vayani.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+#include <csignal>
+#include <cerrno>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <chrono>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "edsm.hpp"
+#include "pipeline.hpp"
+#include "binaryeds.hpp"
+#include "server.hpp"
+
+using namespace std;
+
+/**
+* Set by SIGINT and SIGTERM to stop serving
+*/
+static volatile sig_atomic_t stopServing = 0;
+
+/**
+* The handler of SIGINT and SIGTERM
+*/
+static void stopServer(int)
+{
+    stopServing = 1;
+}
+
+/**
+* The wall clock time
+*
+* @return The time in seconds
+*/
+static double wallTime()
+{
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+* @constructor
+* @param threads The number of threads searching a batch
+*/
+QueryServer::QueryServer(const unsigned int threads)
+{
+    this->threads = threads;
+    this->listener = -1;
+    this->connected = 0;
+    this->firstPending = 0;
+}
+
+/**
+* @destructor
+*/
+QueryServer::~QueryServer()
+{
+    for (auto & c : this->clients) {
+        close(c.second.fd);
+    }
+    if (this->listener >= 0)
+    {
+        close(this->listener);
+        unlink(this->path.c_str());
+    }
+}
+
+/**
+* Add a text to search, after those added before
+*
+* @param t The text as a binary EDS file held in memory, aligned to 8 bytes
+* @param n The length of t
+* @param contig The name of the contig t holds, with which its matches are answered
+*/
+void QueryServer::addText(const char * t, const size_t n, const string & contig)
+{
+    ServerText text;
+    text.contig = contig;
+    text.t = t;
+    text.n = n;
+    this->texts.push_back(text);
+}
+
+/**
+* Create the socket, replacing any file left at its path, e.g. by a server
+* that was killed
+*
+* @param path The path of the socket
+* @return Is the socket accepting connections?
+*/
+bool QueryServer::listen(const string & path)
+{
+    struct sockaddr_un address;
+    if (path.length() == 0 || path.length() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path.c_str());
+
+    this->listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (this->listener < 0) {
+        return false;
+    }
+    unlink(path.c_str());
+    if (bind(this->listener, (struct sockaddr *) &address, sizeof(address)) < 0 || ::listen(this->listener, SOMAXCONN) < 0)
+    {
+        close(this->listener);
+        this->listener = -1;
+        return false;
+    }
+    fcntl(this->listener, F_SETFL, O_NONBLOCK);
+    this->path = path;
+
+    return true;
+}
+
+/**
+* Take a new connection
+*/
+void QueryServer::accept()
+{
+    int fd = ::accept(this->listener, NULL, NULL);
+    if (fd < 0) {
+        return;
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+
+    ServerClient & client = this->clients[this->connected++];
+    client.fd = fd;
+    client.written = 0;
+    client.waiting = 0;
+    client.done = false;
+}
+
+/**
+* Read what a client sent and queue the queries it completes
+*
+* @param key The key of the client
+* @return false if the connection failed or the client sent a line too long to be a query
+*/
+bool QueryServer::receive(const unsigned long int key)
+{
+    ServerClient & client = this->clients[key];
+    char buffer[SERVERREAD];
+    ssize_t r = recv(client.fd, buffer, sizeof(buffer), 0);
+    if (r < 0) {
+        return errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    if (r == 0) {
+        //the client may still wait for its answers, and a last query may lack its line break
+        client.done = true;
+        client.in += '\n';
+    } else {
+        client.in.append(buffer, r);
+    }
+
+    size_t start = 0, end;
+    while ((end = client.in.find('\n', start)) != string::npos)
+    {
+        string line = client.in.substr(start, end - start);
+        if (line.length() > 0 && line[line.length() - 1] == '\r') {
+            line.erase(line.length() - 1);
+        }
+        if (line.length() > 0) {
+            this->addQuery(key, line);
+        }
+        start = end + 1;
+    }
+    client.in.erase(0, start);
+
+    return client.in.length() <= SERVERMAXLINE;
+}
+
+/**
+* Write as much of its answers as a client takes without waiting
+*
+* @param client The client
+* @return false if the connection failed
+*/
+bool QueryServer::send(ServerClient & client)
+{
+    while (client.written < client.out.length())
+    {
+        ssize_t w = ::send(client.fd, client.out.data() + client.written, client.out.length() - client.written, MSG_NOSIGNAL);
+        if (w < 0) {
+            return errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        client.written += w;
+    }
+    client.out.clear();
+    client.written = 0;
+
+    return true;
+}
+
+/**
+* Queue a query for the next batch. A query that cannot be searched is queued
+* too, so the answers of a client keep the order of its queries.
+*
+* @param key The key of the client
+* @param line The query, patterns separated by commas
+*/
+void QueryServer::addQuery(const unsigned long int key, const string & line)
+{
+    ServerQuery query;
+    query.client = key;
+
+    size_t pStart = 0, pEnd;
+    do {
+        pEnd = line.find(',', pStart);
+        string P = line.substr(pStart, pEnd - pStart);
+        pStart = pEnd + 1;
+        if (P.length() == 0) {
+            continue;
+        }
+        if (P.find_first_not_of("ACGT") != string::npos)
+        {
+            query.error = "Error: Invalid character in pattern: '" + P.substr(P.find_first_not_of("ACGT"), 1) + "'!";
+            break;
+        }
+        query.names.push_back(P);
+    } while (pEnd != string::npos);
+    if (query.error.length() == 0 && query.names.size() == 0) {
+        query.error = "Error: No pattern given!";
+    }
+
+    //the distinct patterns of the batch are searched for once each
+    if (query.error.length() == 0)
+    {
+        for (const auto & P : query.names)
+        {
+            auto it = this->patternIndex.find(P);
+            if (it == this->patternIndex.end())
+            {
+                it = this->patternIndex.insert(make_pair(P, (unsigned int) this->patterns.size())).first;
+                this->patterns.push_back(P);
+            }
+            query.patterns.push_back(it->second);
+        }
+    }
+
+    if (this->pending.size() == 0) {
+        this->firstPending = wallTime();
+    }
+    this->pending.push_back(query);
+    this->clients[key].waiting++;
+}
+
+/**
+* Search the texts for all the patterns of the pending queries at once and
+* answer every query with the matches of its patterns
+*/
+void QueryServer::searchBatch()
+{
+    double start = wallTime();
+    unsigned int i;
+
+    //the matches of every pattern in every text
+    vector< vector< vector<int> > > found(this->texts.size(), vector< vector<int> >(this->patterns.size()));
+    if (this->patterns.size() > 0)
+    {
+        EDSM edsm(this->patterns);
+        StringView none = {NULL, 0};
+        for (i = 0; i < this->texts.size(); i++)
+        {
+            const ServerText & text = this->texts[i];
+            BinaryEDS bin;
+            bin.load(text.t, text.n);
+
+            //a text is searched from the start, as if it were the only one
+            vector<StringView> views;
+            PackedView run;
+            edsm.primeWith(none, 0);
+            Pipeline pipeline(edsm, text.t, text.n, this->threads);
+            pipeline.start();
+            pipeline.waitFor(PIPELINEREADCHUNK);
+            while (true)
+            {
+                if (bin.nextPackedSegment(run)) {
+                    pipeline.push(run);
+                } else if (bin.nextSegment(views)) {
+                    pipeline.push(views.data(), views.size());
+                } else {
+                    break;
+                }
+                pipeline.waitFor(bin.getPosition() + PIPELINEREADCHUNK);
+            }
+            pipeline.finish();
+
+            vector<int> matches = edsm.getMatches();
+            vector<unsigned int> matchPatterns = edsm.getMatchPatterns();
+            for (unsigned int k = 0; k < matches.size(); k++) {
+                found[i][matchPatterns[k]].push_back(matches[k]);
+            }
+            edsm.clearMatches();
+        }
+    }
+
+    //the matches of a query of several patterns are merged in position order, text by text
+    for (const auto & query : this->pending)
+    {
+        auto it = this->clients.find(query.client);
+        if (it == this->clients.end()) {
+            continue;
+        }
+        ServerClient & client = it->second;
+        client.waiting--;
+        if (query.error.length() > 0)
+        {
+            client.out += query.error + "\n\n";
+            continue;
+        }
+        for (i = 0; i < this->texts.size(); i++)
+        {
+            vector< pair<int, unsigned int> > answer;
+            for (unsigned int j = 0; j < query.patterns.size(); j++)
+            {
+                for (const auto pos : found[i][query.patterns[j]]) {
+                    answer.push_back(make_pair(pos, j));
+                }
+            }
+            stable_sort(answer.begin(), answer.end());
+            string contig = (this->texts[i].contig.length() > 0) ? this->texts[i].contig + "\t" : "";
+            for (const auto & a : answer) {
+                client.out += contig + to_string(a.first) + "\t" + query.names[a.second] + "\n";
+            }
+        }
+        client.out += "\n";
+    }
+
+    cout << "Searched " << this->pending.size() << " queries for " << this->patterns.size() << " patterns in " << wallTime() - start << "s." << endl;
+
+    this->pending.clear();
+    this->patterns.clear();
+    this->patternIndex.clear();
+}
+
+/**
+* Answer queries until SIGINT or SIGTERM. The queries that arrive while a
+* batch is searched wait in the sockets and make up the next batch.
+*/
+void QueryServer::serve()
+{
+    signal(SIGINT, stopServer);
+    signal(SIGTERM, stopServer);
+    signal(SIGPIPE, SIG_IGN);
+
+    vector<struct pollfd> fds;
+    vector<unsigned long int> keys;
+    struct pollfd p;
+    while (!stopServing)
+    {
+        fds.clear();
+        keys.clear();
+        p.fd = this->listener;
+        p.events = POLLIN;
+        fds.push_back(p);
+        for (const auto & c : this->clients)
+        {
+            //a client that is done is only waited for to take its answers
+            p.fd = (c.second.done && c.second.out.length() == 0) ? -1 : c.second.fd;
+            p.events = (c.second.done ? 0 : POLLIN) | (c.second.out.length() > 0 ? POLLOUT : 0);
+            fds.push_back(p);
+            keys.push_back(c.first);
+        }
+
+        //a batch is searched SERVERBATCHWAIT after its first query came
+        int timeout = 200;
+        if (this->pending.size() > 0) {
+            timeout = max(0, (int) ceil((this->firstPending + SERVERBATCHWAIT - wallTime()) * 1000));
+        }
+        int ready = poll(fds.data(), fds.size(), timeout);
+        if (ready < 0 && errno != EINTR)
+        {
+            cerr << "Error: Failed to wait for queries!" << endl;
+            break;
+        }
+
+        if (ready > 0)
+        {
+            if (fds[0].revents & POLLIN) {
+                this->accept();
+            }
+            for (unsigned int k = 0; k < keys.size(); k++)
+            {
+                short events = fds[k + 1].revents;
+                bool alive = true;
+                if (!this->clients[keys[k]].done && (events & (POLLIN | POLLHUP | POLLERR))) {
+                    alive = this->receive(keys[k]);
+                }
+                if (alive && (events & POLLOUT)) {
+                    alive = this->send(this->clients[keys[k]]);
+                }
+                if (!alive)
+                {
+                    close(this->clients[keys[k]].fd);
+                    this->clients.erase(keys[k]);
+                }
+            }
+        }
+
+        if (this->pending.size() > 0 && (wallTime() >= this->firstPending + SERVERBATCHWAIT || this->patterns.size() >= SERVERBATCHPATTERNS)) {
+            this->searchBatch();
+        }
+
+        //answers are written right away, and a client that is done leaves once it has them all
+        for (auto it = this->clients.begin(); it != this->clients.end(); )
+        {
+            ServerClient & client = it->second;
+            if (!this->send(client) || (client.done && client.waiting == 0 && client.out.length() == 0))
+            {
+                close(client.fd);
+                it = this->clients.erase(it);
+            } else {
+                it++;
+            }
+        }
+    }
+}
@@ -0,0 +1,204 @@
+/*
+    EDSM: Elastic Degenerate String Matching
+
+    Copyright (C) 2017 Chang Liu, Solon P. Pissis, Ahmad Retha and Fatima Vayani.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __SERVER__
+#define __SERVER__
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <map>
+
+#define SERVERBATCHWAIT 0.01
+#define SERVERBATCHPATTERNS 10000
+#define SERVERREAD 65536
+#define SERVERMAXLINE (1 << 24)
+
+/**
+ * A client connected to a QueryServer
+ */
+struct ServerClient
+{
+    /**
+     * @var fd The socket of the connection
+     */
+    int fd;
+
+    /**
+     * @var in What was read from the client and is not a whole query yet
+     */
+    std::string in;
+
+    /**
+     * @var out What is to be written to the client
+     */
+    std::string out;
+
+    /**
+     * @var written How much of out was written
+     */
+    size_t written;
+
+    /**
+     * @var waiting The number of queries of the client not answered yet
+     */
+    unsigned int waiting;
+
+    /**
+     * @var done Did the client stop sending queries?
+     */
+    bool done;
+};
+
+/**
+ * A text searched by a QueryServer, e.g. a contig of a reference
+ */
+struct ServerText
+{
+    /**
+     * @var contig The name of the contig, empty if the text is not one
+     */
+    std::string contig;
+
+    /**
+     * @var t The text as a binary EDS file held in memory
+     */
+    const char * t;
+
+    /**
+     * @var n The length of t
+     */
+    size_t n;
+};
+
+/**
+ * A query waiting for its batch to be searched
+ */
+struct ServerQuery
+{
+    /**
+     * @var client The key of the client that sent it
+     */
+    unsigned long int client;
+
+    /**
+     * @var patterns The index of each pattern of the query among the patterns of the batch
+     */
+    std::vector<unsigned int> patterns;
+
+    /**
+     * @var names The patterns of the query
+     */
+    std::vector<std::string> names;
+
+    /**
+     * @var error Why the query cannot be searched, empty if it can
+     */
+    std::string error;
+};
+
+/**
+ * Answers pattern queries on a text held in memory over a Unix domain socket.
+ * A query is a line holding one or more patterns separated by commas, and is
+ * answered with a line per match, its position and its pattern separated by a
+ * tab, followed by an empty line; a query that cannot be searched is answered
+ * with a line starting with "Error:" and an empty line. The server may hold
+ * several texts, the contigs of a reference, which are searched one after the
+ * other; a match in a named contig starts with the name and a tab. The queries that
+ * arrive within SERVERBATCHWAIT seconds of each other, or while a batch is
+ * being searched, make up one batch whose distinct patterns are searched for
+ * in a single pass over the text.
+ */
+class QueryServer
+{
+protected:
+
+    /**
+     * @var texts The texts searched, in the order their matches are answered in
+     */
+    std::vector<ServerText> texts;
+
+    /**
+     * @var threads The number of threads searching a batch
+     */
+    unsigned int threads;
+
+    /**
+     * @var listener The socket accepting connections
+     */
+    int listener;
+
+    /**
+     * @var path The path of the socket
+     */
+    std::string path;
+
+    /**
+     * @var clients The connected clients, by the order they connected in
+     */
+    std::map<unsigned long int, ServerClient> clients;
+
+    /**
+     * @var connected The number of clients that connected so far
+     */
+    unsigned long int connected;
+
+    /**
+     * @var pending The queries of the next batch
+     */
+    std::vector<ServerQuery> pending;
+
+    /**
+     * @var patterns The distinct patterns of the pending queries
+     */
+    std::vector<std::string> patterns;
+
+    /**
+     * @var patternIndex The index of every pattern in patterns
+     */
+    std::map<std::string, unsigned int> patternIndex;
+
+    /**
+     * @var firstPending When the first pending query arrived
+     */
+    double firstPending;
+
+    void accept();
+
+    bool receive(const unsigned long int key);
+
+    bool send(ServerClient & client);
+
+    void addQuery(const unsigned long int key, const std::string & line);
+
+    void searchBatch();
+
+public:
+
+    QueryServer(const unsigned int threads = 1);
+
+    ~QueryServer();
+
+    void addText(const char * t, const size_t n, const std::string & contig = "");
+
+    bool listen(const std::string & path);
+
+    void serve();
+
+};
+
+#endif
@@ -0,0 +1,267 @@
+/*
+    EDSM: Elastic Degenerate String Matching
+
+    Copyright (C) 2017 Chang Liu, Solon P. Pissis, Ahmad Retha and Fatima Vayani.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "tokenizer.hpp"
+
+using namespace std;
+
+/**
+* @constructor
+* @param t The EDS text
+* @param n The length of t
+* @param source The file t is being decompressed into, to wait for, or NULL if t is all in memory
+*/
+EDSTokenizer::EDSTokenizer(const char * t, const size_t n, MappedFile * source)
+{
+    this->t = t;
+    this->n = n;
+    this->source = source;
+    this->ready = (source == NULL) ? n : 0;
+    this->i = 0;
+    this->windowStart = 0;
+    this->windowEnd = 0;
+    this->invalid = n;
+    this->classify = getKernels().classify;
+    this->classes.resize(TOKENIZERWINDOW / 64);
+}
+
+/**
+* Wait until the text up to p has been decompressed
+*
+* @param p The end of the part of the text about to be read
+*/
+void EDSTokenizer::require(const size_t p)
+{
+    if (p > this->ready) {
+        this->ready = this->source->fill(p);
+    }
+}
+
+/**
+* Classify the window of text containing position at. The last partial block
+* is classified from a copy padded with line breaks, which are skipped.
+*
+* @param at The position the window must contain
+*/
+void EDSTokenizer::loadWindow(const size_t at)
+{
+    char tail[64];
+    size_t b, full;
+    WORD bad;
+
+    this->windowStart = at & ~((size_t) 63);
+    this->windowEnd = min(this->n, this->windowStart + TOKENIZERWINDOW);
+    this->require(this->windowEnd);
+    full = (this->windowEnd - this->windowStart) / 64;
+    this->classify(this->t + this->windowStart, full, this->classes.data());
+    if (this->windowStart + full * 64 < this->windowEnd)
+    {
+        memset(tail, '\n', 64);
+        memcpy(tail, this->t + this->windowStart + full * 64, this->windowEnd - this->windowStart - full * 64);
+        this->classify(tail, 1, this->classes.data() + full);
+    }
+
+    //find the first invalid character of the window, if any
+    for (b = 0; b * 64 < this->windowEnd - this->windowStart; b++)
+    {
+        bad = ~(this->classes[b].base | this->classes[b].delim | this->classes[b].skip);
+        if (bad != 0)
+        {
+            this->invalid = min(this->invalid, this->windowStart + b * 64 + __builtin_ctzl(bad));
+            break;
+        }
+    }
+}
+
+/**
+* Find the end of the run of bases starting at i
+*
+* @param e Do not look at or past this position
+* @param lower Set to whether any base of the run is in lower case
+* @return The position of the first character of [i, e) that is not a base, or e
+*/
+size_t EDSTokenizer::runEnd(const size_t e, bool & lower)
+{
+    size_t p = this->i, b, len;
+    unsigned int bit;
+    WORD stop, run;
+
+    lower = false;
+    while (p < e)
+    {
+        if (p < this->windowStart || p >= this->windowEnd) {
+            this->loadWindow(p);
+        }
+        b = (p - this->windowStart) / 64;
+        bit = p % 64;
+        stop = ~this->classes[b].base >> bit;
+        len = (stop == 0) ? 64 - bit : __builtin_ctzl(stop);
+        len = min(len, e - p);
+        run = (len == 64) ? ~0ul : (1ul << len) - 1;
+        if ((this->classes[b].lower >> bit) & run) {
+            lower = true;
+        }
+        p += len;
+        if (len < 64 - bit) {
+            break;
+        }
+    }
+
+    return p;
+}
+
+/**
+* Take the next string of at most limit bases from [i, e), stopping at a
+* delimiter. Skipped characters or lower case bases make the string a copy,
+* folded to upper case, at the end of buffer.
+*
+* @param e The end of the part of the text to read
+* @param limit The maximum number of bases to take
+* @return The string
+*/
+StringView EDSTokenizer::nextString(const size_t e, const size_t limit)
+{
+    StringView a;
+    size_t k = 0, q, start, j;
+    bool lower, compact = false;
+    char c;
+
+    a.data = this->t + this->i;
+    while (this->i < e && k < limit)
+    {
+        q = this->runEnd(min(e, this->i + (limit - k)), lower);
+        if (q > this->i)
+        {
+            if (lower && !compact)
+            {
+                compact = true;
+                start = this->buffer.length();
+                this->buffer.append(a.data, k);
+                a.data = this->buffer.data() + start;
+            }
+            if (compact)
+            {
+                start = this->buffer.length();
+                this->buffer.resize(start + q - this->i);
+                for (j = 0; j < q - this->i; j++) {
+                    this->buffer[start + j] = this->t[this->i + j] & ~0x20;
+                }
+            }
+            else if (k == 0)
+            {
+                a.data = this->t + this->i;
+            }
+            k += q - this->i;
+            this->i = q;
+            continue;
+        }
+
+        c = this->t[this->i];
+        if (c == '{' || c == ',' || c == '}') {
+            break;
+        }
+        if (k > 0 && !compact)
+        {
+            compact = true;
+            start = this->buffer.length();
+            this->buffer.append(a.data, k);
+            a.data = this->buffer.data() + start;
+        }
+        this->i++;
+    }
+    a.length = k;
+
+    return a;
+}
+
+/**
+* Read the next segment. Determinate segments longer than BUFFERSIZE are
+* handed out in pieces of BUFFERSIZE bases.
+*
+* @param S Set to the strings of the segment, epsilon being an empty string; valid until the next call
+* @return false at the end of the text or at an invalid character
+*/
+bool EDSTokenizer::nextSegment(vector<StringView> & S)
+{
+    StringView a;
+    size_t e;
+
+    S.clear();
+    this->buffer.clear();
+    while (this->i < this->n && this->invalid >= this->i)
+    {
+        this->require(this->i + 1);
+        if (this->t[this->i] == '{')
+        {
+            //a degenerate segment, up to the closing brace
+            const char * close = NULL;
+            for (e = this->i; close == NULL && e < this->n; e = min(this->n, e + TOKENIZERWINDOW))
+            {
+                this->require(min(this->n, e + TOKENIZERWINDOW));
+                close = (const char *) memchr(this->t + e, '}', min(this->n, e + TOKENIZERWINDOW) - e);
+            }
+            e = (close == NULL) ? this->n : close - this->t;
+            this->buffer.reserve(e - this->i);
+            this->i++;
+            S.push_back(this->nextString(e, e));
+            while (this->i < e && this->t[this->i] == ',')
+            {
+                this->i++;
+                S.push_back(this->nextString(e, e));
+            }
+            this->i = e + 1;
+            return this->invalid >= this->i;
+        }
+
+        //a determinate segment
+        this->buffer.reserve(BUFFERSIZE);
+        a = this->nextString(this->n, BUFFERSIZE);
+        if (a.length > 0)
+        {
+            S.push_back(a);
+            return this->invalid >= this->i;
+        }
+        if (this->i < this->n && this->t[this->i] != '{') {
+            //a stray ',' or '}'
+            this->i++;
+        }
+    }
+
+    return false;
+}
+
+/**
+* Get the position of the first invalid character, which stopped the tokenizer
+*
+* @return The position, or the length of the text if every character was valid
+*/
+size_t EDSTokenizer::getInvalid() const
+{
+    return this->invalid;
+}
+
+/**
+* Get the position of the next character to read
+*/
+size_t EDSTokenizer::getPosition() const
+{
+    return this->i;
+}
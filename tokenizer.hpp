@@ -0,0 +1,122 @@
+/*
+    EDSM: Elastic Degenerate String Matching
+
+    Copyright (C) 2017 Chang Liu, Solon P. Pissis, Ahmad Retha and Fatima Vayani.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __TOKENIZER__
+#define __TOKENIZER__
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "edsm.hpp"
+#include "kernels.hpp"
+#include "mappedfile.hpp"
+
+#define TOKENIZERWINDOW (1 << 20)
+
+/**
+ * Splits EDS text, e.g. ACGT{A,CG,E}TT, into segments. The text is classified
+ * a window at a time by the vector kernel of the processor, so runs of bases
+ * are skipped 64 characters at a time by looking at bit masks, and invalid
+ * characters are caught on the way.
+ *
+ * The strings of a segment point straight into the text. Only strings split
+ * by skipped characters such as line breaks, or holding lower case
+ * (soft-masked) bases that have to be folded to upper case, are copied.
+ *
+ * The text may be a file still being decompressed: no character is read
+ * before the file has been filled up to it.
+ */
+class EDSTokenizer
+{
+protected:
+
+    /**
+     * @var t The EDS text
+     */
+    const char * t;
+
+    /**
+     * @var n The length of t
+     */
+    size_t n;
+
+    /**
+     * @var source The file t is decompressed into as it is read, or NULL if t is all there
+     */
+    MappedFile * source;
+
+    /**
+     * @var ready The text up to here can be read
+     */
+    size_t ready;
+
+    /**
+     * @var i The position of the next character to read
+     */
+    size_t i;
+
+    /**
+     * @var windowStart The first character of the classified window, a multiple of 64
+     */
+    size_t windowStart;
+
+    /**
+     * @var windowEnd The end of the classified window
+     */
+    size_t windowEnd;
+
+    /**
+     * @var classes The classes of the blocks of the window
+     */
+    std::vector<CharClasses> classes;
+
+    /**
+     * @var classify The classification kernel
+     */
+    ClassifyKernel classify;
+
+    /**
+     * @var invalid The position of the first invalid character found, n if there is none
+     */
+    size_t invalid;
+
+    /**
+     * @var buffer The copies of the strings of the current segment that could not be views
+     */
+    std::string buffer;
+
+    void require(const size_t p);
+
+    void loadWindow(const size_t at);
+
+    size_t runEnd(const size_t e, bool & lower);
+
+    StringView nextString(const size_t e, const size_t limit);
+
+public:
+
+    EDSTokenizer(const char * t, const size_t n, MappedFile * source = NULL);
+
+    bool nextSegment(std::vector<StringView> & S);
+
+    size_t getInvalid() const;
+
+    size_t getPosition() const;
+
+};
+
+#endif
@@ -0,0 +1,217 @@
+/*
+    EDSM: Elastic Degenerate String Matching
+
+    Copyright (C) 2017 Chang Liu, Solon P. Pissis, Ahmad Retha and Fatima Vayani.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include "vcfreader.hpp"
+
+using namespace std;
+
+/**
+* @constructor
+*/
+VCFReader::VCFReader()
+{
+    this->fp = NULL;
+    this->tbx = NULL;
+    this->itr = NULL;
+    this->line.l = this->line.m = 0;
+    this->line.s = NULL;
+    this->pending = false;
+    this->position = 0;
+}
+
+/**
+* @destructor
+*/
+VCFReader::~VCFReader()
+{
+    this->close();
+    free(this->line.s);
+}
+
+/**
+* Open a VCF file and read its first record
+*
+* @param name The path of the file
+* @param pool The threads that decompress BGZF blocks, or NULL to decompress on this thread
+* @param contig Only read the records of this contig, or all the records if empty
+* @return Was the file opened?
+*/
+bool VCFReader::open(const string & name, htsThreadPool * pool, const string & contig)
+{
+    this->close();
+    this->fp = hts_open(name.c_str(), "r");
+    if (this->fp == NULL) {
+        return false;
+    }
+    if (pool != NULL && pool->pool != NULL) {
+        hts_set_thread_pool(this->fp, pool);
+    }
+
+    if (contig.length() > 0)
+    {
+        //jump straight to the contig with the tabix index, or filter on CHROM without one
+        this->tbx = tbx_index_load3(name.c_str(), NULL, HTS_IDX_SILENT_FAIL);
+        if (this->tbx != NULL)
+        {
+            this->itr = tbx_itr_querys(this->tbx, contig.c_str());
+            if (this->itr == NULL) {
+                //no records for the contig
+                return true;
+            }
+        }
+        else
+        {
+            this->contig = contig;
+        }
+    }
+    this->pending = this->readRecord();
+
+    return true;
+}
+
+/**
+* Close the file
+*/
+void VCFReader::close()
+{
+    if (this->itr != NULL)
+    {
+        hts_itr_destroy(this->itr);
+        this->itr = NULL;
+    }
+    if (this->tbx != NULL)
+    {
+        tbx_destroy(this->tbx);
+        this->tbx = NULL;
+    }
+    if (this->fp != NULL)
+    {
+        hts_close(this->fp);
+        this->fp = NULL;
+    }
+    this->contig.clear();
+    this->pending = false;
+}
+
+/**
+* Read the next record into line, skipping the header, malformed lines and the
+* records of other contigs, and find its POS, REF and ALT columns
+*
+* @return false at the end of the file
+*/
+bool VCFReader::readRecord()
+{
+    const char * s, * e, * tab[4];
+    unsigned int k;
+
+    while ((this->itr != NULL) ? tbx_itr_next(this->fp, this->tbx, this->itr, &this->line) >= 0 : hts_getline(this->fp, KS_SEP_LINE, &this->line) >= 0)
+    {
+        s = this->line.s;
+        e = s + this->line.l;
+        if (this->line.l == 0 || s[0] == '#') {
+            continue;
+        }
+
+        //CHROM, POS, ID and REF end at the first four tabs, ALT at the fifth or the end of the line
+        for (k = 0; k < 4; k++)
+        {
+            tab[k] = (const char *) memchr(s, '\t', e - s);
+            if (tab[k] == NULL) {
+                break;
+            }
+            s = tab[k] + 1;
+        }
+        if (k < 4) {
+            continue;
+        }
+        if (this->contig.length() > 0 && (tab[0] - this->line.s != (long) this->contig.length() || memcmp(this->line.s, this->contig.data(), this->contig.length()) != 0)) {
+            continue;
+        }
+        const char * altEnd = (const char *) memchr(s, '\t', e - s);
+        if (altEnd == NULL) {
+            altEnd = e;
+        }
+
+        this->position = (unsigned int) strtoul(tab[0] + 1, NULL, 10);
+        this->ref.data = tab[2] + 1;
+        this->ref.length = tab[3] - tab[2] - 1;
+        this->alt.data = s;
+        this->alt.length = altEnd - s;
+        return true;
+    }
+
+    return false;
+}
+
+/**
+* Append the comma separated alleles of a REF or ALT column. The bases are
+* folded to upper case and anything but A, C, G and T, such as an IUPAC code,
+* becomes N, as in the tokenizer, since the kernels only tell those apart.
+*
+* @param column The column
+* @param alleles The alleles of the site
+*/
+void VCFReader::addAlleles(const StringView & column, Segment & alleles)
+{
+    const char * s = column.data, * e = column.data + column.length, * comma;
+
+    while (s < e)
+    {
+        comma = (const char *) memchr(s, ',', e - s);
+        if (comma == NULL) {
+            comma = e;
+        }
+        if (comma > s && s[0] != '<' && !(comma - s == 1 && s[0] == '.'))
+        {
+            alleles.push_back(string(s, comma - s));
+            for (auto & c : alleles.back())
+            {
+                c &= ~0x20;
+                if (!(c == 'A' || c == 'C' || c == 'G' || c == 'T')) {
+                    c = 'N';
+                }
+            }
+        }
+        s = comma + 1;
+    }
+}
+
+/**
+* Read the next variant site: all the records at the next position
+*
+* @param position Set to the position of the site
+* @param alleles The alleles of the site are appended to it
+* @return false if there are no more sites
+*/
+bool VCFReader::nextSite(unsigned int & position, Segment & alleles)
+{
+    if (!this->pending) {
+        return false;
+    }
+
+    position = this->position;
+    this->addAlleles(this->ref, alleles);
+    this->addAlleles(this->alt, alleles);
+    while ((this->pending = this->readRecord()) && this->position == position) {
+        this->addAlleles(this->alt, alleles);
+    }
+
+    return true;
+}
@@ -0,0 +1,109 @@
+/*
+    EDSM: Elastic Degenerate String Matching
+
+    Copyright (C) 2017 Chang Liu, Solon P. Pissis, Ahmad Retha and Fatima Vayani.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __VCFREADER__
+#define __VCFREADER__
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <htslib/hts.h>
+#include <htslib/kstring.h>
+#include <htslib/tbx.h>
+#include "edsm.hpp"
+
+/**
+ * A streaming reader of the variant sites of a VCF file, plain or compressed.
+ * Only POS, REF and ALT are needed, so a record is tokenized up to the end of
+ * its ALT column and the INFO and genotype columns, thousands of them in
+ * population-scale files, are never looked at.
+ *
+ * The records of one position are merged into a single site: the first record
+ * gives its REF and ALT alleles, the following ones their ALT alleles only.
+ * Symbolic alleles such as <DEL> and the missing value '.' are left out.
+ *
+ * The sites of a single contig are read through the tabix index when there is
+ * one, and otherwise by skipping the records of the other contigs.
+ */
+class VCFReader
+{
+protected:
+
+    /**
+     * @var fp The open file, NULL if there is none
+     */
+    htsFile * fp;
+
+    /**
+     * @var tbx The tabix index, NULL if there is none or all contigs are read
+     */
+    tbx_t * tbx;
+
+    /**
+     * @var itr The iterator over the records of the contig in the index
+     */
+    hts_itr_t * itr;
+
+    /**
+     * @var contig The contig whose records are kept when there is no index, empty for all of them
+     */
+    std::string contig;
+
+    /**
+     * @var line The last record read
+     */
+    kstring_t line;
+
+    /**
+     * @var pending Does line hold a record that has not been handed out yet?
+     */
+    bool pending;
+
+    /**
+     * @var position The POS of the record in line
+     */
+    unsigned int position;
+
+    /**
+     * @var ref The REF column of the record in line
+     */
+    StringView ref;
+
+    /**
+     * @var alt The ALT column of the record in line
+     */
+    StringView alt;
+
+    bool readRecord();
+
+    void addAlleles(const StringView & column, Segment & alleles);
+
+public:
+
+    VCFReader();
+
+    ~VCFReader();
+
+    bool open(const std::string & name, htsThreadPool * pool = NULL, const std::string & contig = "");
+
+    void close();
+
+    bool nextSite(unsigned int & position, Segment & alleles);
+
+};
+
+#endif